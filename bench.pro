@@ -0,0 +1,30 @@
+QT       += core gui opengl
+
+CXX_FLAGS += -std=c++11
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = bench
+TEMPLATE = app
+
+# Built next to cube, keep the objects of the shared sources apart
+OBJECTS_DIR = bench-obj
+MOC_DIR = bench-obj
+
+SOURCES += benchmain.cpp \
+    microbench.cpp \
+    engine.cpp \
+    config.cpp \
+    ephemeris.cpp \
+    keyframes.cpp \
+    profiler.cpp \
+    trace.cpp
+
+HEADERS += \
+    microbench.h \
+    engine.h \
+    config.h \
+    ephemeris.h \
+    keyframes.h \
+    profiler.h \
+    trace.h
@@ -0,0 +1,23 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+
+#include "microbench.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("bench");
+    app.setApplicationVersion("0.1");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Ephemeris and mesh microbenchmarks with accuracy checks.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("file", "JSON report to write.");
+    parser.process(app);
+
+    QStringList const args = parser.positionalArguments();
+    if (args.size() != 1)
+        parser.showHelp(1);
+
+    return MicroBenchmark(args.first()).run();
+}
@@ -0,0 +1,132 @@
+#include <QCryptographicHash>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <algorithm>
+
+#include "benchmark.h"
+#include "camerapath.h"
+#include "offscreen.h"
+
+namespace {
+
+struct Scenario
+{
+	char const *name;
+	bool survey;
+	// Simulated seconds per frame
+	qint64 step;
+	CameraPath path;
+};
+
+double percentile(std::vector<double> const &sorted, double p)
+{
+	return sorted[static_cast<int>(p * (sorted.size() - 1))];
+}
+
+}
+
+Benchmark::Benchmark(QString const &outputDir_, QSize const &size_, int frames_)
+	:outputDir(outputDir_),
+	size(size_),
+	frames(frames_)
+{}
+
+int Benchmark::run()
+{
+	OffscreenTarget target(size);
+	if (!target.init())
+		return 1;
+
+	QElapsedTimer startup;
+	startup.start();
+	Renderer renderer;
+	if (!renderer.init(target.glContext())) {
+		qWarning() << "benchmark: could not initialize the renderer";
+		return 1;
+	}
+	glFinish();
+	double startupMs = startup.nsecsElapsed() / 1e6;
+	glViewport(0, 0, size.width(), size.height());
+
+	Scenario const scenarios[] = {
+		{"orbit", false, 60 * 60, orbitPath},
+		{"flyto", false, 60 * 60, flyToPath},
+		{"survey", true, 60 * 60 * 24, surveyPath}
+	};
+
+	QDir().mkpath(outputDir);
+	QDateTime const start(QDate(2000, 1, 1), QTime(12, 0), Qt::UTC);
+
+	QJsonArray results;
+	for (auto const &scenario : scenarios) {
+		renderer.clearKeyframes();
+
+		Camera camera;
+		camera.aspect = qreal(size.width()) / size.height();
+		camera.survey = scenario.survey;
+
+		std::vector<double> times;
+		for (int frame = 0; frame < frames; ++frame) {
+			QElapsedTimer timer;
+			timer.start();
+			renderer.changeTime(start.addMSecs(scenario.step * 1000 * frame));
+			scenario.path(renderer, camera, frames > 1 ? double(frame) / (frames - 1) : 0);
+			renderer.update(camera);
+			renderer.render(camera);
+			glFinish();
+			times.push_back(timer.nsecsElapsed() / 1e6);
+		}
+
+		QImage image = target.fbo->toImage();
+		QString imageFile = QDir(outputDir).filePath(QString("%1.png").arg(scenario.name));
+		if (!image.save(imageFile)) {
+			qWarning() << "benchmark: could not write" << imageFile;
+			return 1;
+		}
+		// Row by row, so scanline padding does not enter the checksum
+		QCryptographicHash checksum(QCryptographicHash::Sha1);
+		int rowBytes = image.width() * image.depth() / 8;
+		for (int y = 0; y < image.height(); ++y)
+			checksum.addData(reinterpret_cast<char const *>(image.constScanLine(y)), rowBytes);
+
+		double total = 0;
+		for (double time : times)
+			total += time;
+		std::sort(times.begin(), times.end());
+
+		QJsonObject result;
+		result["name"] = scenario.name;
+		result["frames"] = frames;
+		result["mean_ms"] = total / times.size();
+		result["p50_ms"] = percentile(times, .5);
+		result["p90_ms"] = percentile(times, .9);
+		result["p99_ms"] = percentile(times, .99);
+		result["max_ms"] = times.back();
+		result["checksum"] = QString(checksum.result().toHex());
+		results.append(result);
+
+		qDebug() << "benchmark:" << scenario.name << "mean" << total / times.size() << "ms, p99" << percentile(times, .99) << "ms";
+	}
+
+	QJsonObject report;
+	report["renderer"] = QString(reinterpret_cast<char const *>(glGetString(GL_RENDERER)));
+	report["width"] = size.width();
+	report["height"] = size.height();
+	report["startup_ms"] = startupMs;
+	report["shader_ms"] = renderer.shaderMs;
+	ShaderCache const &cache = renderer.shaderCache;
+	report["shader_cache"] = !ShaderCache::enabled ? "off"
+		: !cache.supported() ? "unsupported"
+		: cache.misses ? "cold" : "warm";
+	report["scenarios"] = results;
+
+	QFile file(QDir(outputDir).filePath("benchmark.json"));
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return 1;
+	file.write(QJsonDocument(report).toJson());
+	return 0;
+}
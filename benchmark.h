@@ -0,0 +1,17 @@
+#pragma once
+
+#include <QString>
+#include <QSize>
+
+// Renders scripted camera paths into an offscreen framebuffer with a fixed
+// simulation clock, then writes frame time statistics and the last frame
+// of every scenario to outputDir
+struct Benchmark
+{
+	Benchmark(QString const &outputDir_, QSize const &size_, int frames_);
+	int run();
+
+	QString const outputDir;
+	QSize const size;
+	int const frames;
+};
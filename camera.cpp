@@ -0,0 +1,67 @@
+#include <cmath>
+#include <algorithm>
+
+#include "camera.h"
+#include "config.h"
+
+Camera::Camera()
+	:zNear(0.00002),
+	zFar(15.0),
+	viewAngle(45.0),
+	aspect(1.0),
+	survey(false)
+{}
+
+void Camera::viewUp(float alpha)
+{
+	float lim = M_PI / 2.0 - M_PI / 100.0;
+	direction.setY(std::min(std::max(direction.y() + alpha, -lim), lim));
+}
+
+void Camera::viewRight(float alpha)
+{
+	direction.setX(direction.x() + alpha);
+	if (direction.x() < -M_PI)
+		direction += QVector2D(2*M_PI, 0);
+	if (direction.x() > M_PI)
+		direction -= QVector2D(2*M_PI, 0);
+}
+
+QVector3D Camera::getDirection() const
+{
+	QVector3D direct(
+		std::cos(direction.y()) * std::sin(direction.x()),
+		std::sin(direction.y()),
+		-std::cos(direction.y()) * std::cos(direction.x()));
+	direct.normalize();
+	return direct;
+}
+
+void Camera::viewForward(float delta)
+{
+	position += getDirection() * delta;
+}
+
+void Camera::lookAt(QVector3D const &target)
+{
+	QVector3D move = target - position;
+	float x = std::atan2(move.x(), -move.z());
+	float y = std::atan2(move.y(), std::pow(move.x() * move.x() + move.z() * move.z(), .5f));
+	viewRight(x - direction.x());
+	viewUp(y - direction.y());
+}
+
+QMatrix4x4 Camera::rotation() const
+{
+	QMatrix4x4 matrix;
+	matrix.rotate(-direction.y() / M_PI * 180, 1, 0, 0);
+	matrix.rotate(direction.x() / M_PI * 180, 0, 1, 0);
+	return matrix;
+}
+
+QMatrix4x4 Camera::projection() const
+{
+	QMatrix4x4 matrix;
+	matrix.perspective(viewAngle, aspect, zNear, zFar);
+	return matrix;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QVector2D>
+#include <QVector3D>
+#include <QMatrix4x4>
+
+struct Camera
+{
+	Camera();
+
+	QVector3D getDirection() const;
+	void viewUp(float alpha);
+	void viewRight(float alpha);
+	void viewForward(float delta);
+	void lookAt(QVector3D const &target);
+
+	QMatrix4x4 rotation() const;
+	QMatrix4x4 projection() const;
+
+	QVector3D position;
+	// yaw and pitch in radians
+	QVector2D direction;
+	qreal zNear, zFar, viewAngle;
+	qreal aspect;
+	// Draw planets at the log scaled distances of survey mode
+	bool survey;
+};
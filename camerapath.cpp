@@ -0,0 +1,51 @@
+#include <algorithm>
+#include <cmath>
+
+#include "camerapath.h"
+
+static double smoothStep(double t)
+{
+	return t * t * (3 - 2 * t);
+}
+
+QVector3D nearPlanet(PlanetEngine const &planet)
+{
+	QVector3D away = (-planet.worldPosition.normalized() + QVector3D(0, .3, 0)).normalized();
+	return planet.worldPosition + away * planet.radius * 6;
+}
+
+void orbitPath(Renderer &, Camera &camera, double t)
+{
+	double angle = 2 * M_PI * t;
+	camera.position = QVector3D(3 * std::sin(angle), .5, 3 * std::cos(angle));
+	camera.lookAt(QVector3D());
+}
+
+void flyToPath(Renderer &renderer, Camera &camera, double t)
+{
+	int count = renderer.planets.size();
+	int idx = std::min(static_cast<int>(t * count), count - 1);
+	double u = t * count - idx;
+	QVector3D from = idx ? nearPlanet(*renderer.planets[idx - 1]) : QVector3D(0, .5, 3);
+	QVector3D to = nearPlanet(*renderer.planets[idx]);
+	camera.position = from + (to - from) * smoothStep(std::min(1.0, u * 1.25));
+	camera.lookAt(renderer.planets[idx]->worldPosition);
+}
+
+void surveyPath(Renderer &, Camera &camera, double t)
+{
+	double angle = M_PI * t;
+	camera.position = QVector3D(.008 * std::sin(angle), .004, .008 * std::cos(angle));
+	camera.lookAt(QVector3D());
+}
+
+CameraPath findCameraPath(QString const &name)
+{
+	if (name == "orbit")
+		return orbitPath;
+	if (name == "flyto")
+		return flyToPath;
+	if (name == "survey")
+		return surveyPath;
+	return 0;
+}
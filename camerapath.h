@@ -0,0 +1,18 @@
+#pragma once
+
+#include <QString>
+
+#include "renderer.h"
+
+// Scripted camera movement, places the camera for t in [0, 1]
+typedef void (*CameraPath)(Renderer &renderer, Camera &camera, double t);
+
+void orbitPath(Renderer &renderer, Camera &camera, double t);
+void flyToPath(Renderer &renderer, Camera &camera, double t);
+void surveyPath(Renderer &renderer, Camera &camera, double t);
+
+// A point a few radii away from the planet, on its sunlit side
+QVector3D nearPlanet(PlanetEngine const &planet);
+
+// orbit, flyto or survey; 0 for unknown names
+CameraPath findCameraPath(QString const &name);
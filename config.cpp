@@ -172,4 +172,314 @@ PlanetConfig::Config const PlanetConfig::cnf[PlanetConfig::count] = {
 	}
 };
 
-bool PlanetConfig::modeSurvey = false;
+// Orbits are relative to the parent planet
+PlanetConfig::Moon const PlanetConfig::moons[PlanetConfig::moonCount] = {
+	{
+		earth,
+		{
+			"moon",
+
+			1737,
+			0.0025695553,
+			0.0549,
+			5.145,
+			218.316,
+			83.353,
+			125.045,
+			27.321661,
+
+			0.0,
+			0.0,
+			0.0,
+			481266.49401001,
+			4069.0137,
+			-1934.1363
+		}
+	},
+	{
+		mars,
+		{
+			"phobos",
+
+			11,
+			0.0000626747,
+			0.0151,
+			26.04,
+			35.06,
+			150.06,
+			82.63,
+			0.31891023,
+
+			0.0,
+			0.0,
+			0.0,
+			41231038.59038953,
+			0.0,
+			0.0
+		}
+	},
+	{
+		mars,
+		{
+			"deimos",
+
+			6,
+			0.0001568405,
+			0.00033,
+			27.58,
+			79.41,
+			260.73,
+			79.46,
+			1.263,
+
+			0.0,
+			0.0,
+			0.0,
+			10410926.36579573,
+			0.0,
+			0.0
+		}
+	},
+	{
+		jupiter,
+		{
+			"io",
+
+			1821,
+			0.0028188904,
+			0.0041,
+			2.21,
+			200.39,
+			84.13,
+			336.37,
+			1.769137786,
+
+			0.0,
+			0.0,
+			0.0,
+			7432434.09532829,
+			0.0,
+			0.0
+		}
+	},
+	{
+		jupiter,
+		{
+			"europa",
+
+			1561,
+			0.0044855852,
+			0.009,
+			1.79,
+			36.02,
+			88.97,
+			329.14,
+			3.551181,
+
+			0.0,
+			0.0,
+			0.0,
+			3702711.85839302,
+			0.0,
+			0.0
+		}
+	},
+	{
+		jupiter,
+		{
+			"ganymede",
+
+			2634,
+			0.0071552623,
+			0.0013,
+			2.21,
+			53.35,
+			192.42,
+			342.37,
+			7.15455296,
+
+			0.0,
+			0.0,
+			0.0,
+			1837850.67683670,
+			0.0,
+			0.0
+		}
+	},
+	{
+		jupiter,
+		{
+			"callisto",
+
+			2410,
+			0.0125851323,
+			0.0074,
+			2.02,
+			187.97,
+			52.64,
+			338.16,
+			16.6890184,
+
+			0.0,
+			0.0,
+			0.0,
+			787883.36646570,
+			0.0,
+			0.0
+		}
+	},
+	{
+		saturn,
+		{
+			"rhea",
+
+			764,
+			0.0035234993,
+			0.0013,
+			27.5,
+			311.55,
+			241.62,
+			133.73,
+			4.518212,
+
+			0.0,
+			0.0,
+			0.0,
+			2910222.00817492,
+			0.0,
+			0.0
+		}
+	},
+	{
+		saturn,
+		{
+			"titan",
+
+			2575,
+			0.0081676965,
+			0.0288,
+			27.5,
+			15.15,
+			180.53,
+			169.53,
+			15.945,
+
+			0.0,
+			0.0,
+			0.0,
+			824647.22483537,
+			0.0,
+			0.0
+		}
+	},
+	{
+		saturn,
+		{
+			"iapetus",
+
+			735,
+			0.0238026115,
+			0.0286,
+			17.28,
+			356.03,
+			271.61,
+			81.11,
+			79.3215,
+
+			0.0,
+			0.0,
+			0.0,
+			165768.42344131,
+			0.0,
+			0.0
+		}
+	},
+	{
+		uranus,
+		{
+			"titania",
+
+			789,
+			0.0029138784,
+			0.0011,
+			97.8,
+			24.61,
+			284.4,
+			167.69,
+			8.706234,
+
+			0.0,
+			0.0,
+			0.0,
+			1510297.10435074,
+			0.0,
+			0.0
+		}
+	},
+	{
+		uranus,
+		{
+			"oberon",
+
+			761,
+			0.0039005903,
+			0.0014,
+			97.9,
+			283.09,
+			104.4,
+			167.72,
+			13.463234,
+
+			0.0,
+			0.0,
+			0.0,
+			976659.84264999,
+			0.0,
+			0.0
+		}
+	},
+	{
+		neptune,
+		{
+			"triton",
+
+			1353,
+			0.0023714174,
+			1.6e-05,
+			130.0,
+			264.77,
+			66.14,
+			177.61,
+			5.876854,
+
+			0.0,
+			0.0,
+			0.0,
+			2237421.58644744,
+			0.0,
+			0.0
+		}
+	},
+	{
+		pluto,
+		{
+			"charon",
+
+			606,
+			0.0001309577,
+			0.0002,
+			119.6,
+			147.85,
+			146.1,
+			223.05,
+			6.3872,
+
+			0.0,
+			0.0,
+			0.0,
+			2058648.54709419,
+			0.0,
+			0.0
+		}
+	}
+};
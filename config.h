@@ -41,6 +41,15 @@ struct PlanetConfig
 		double delta_an_long;
 	};
 
+	struct Moon {
+		names parent;
+		Config cnf;
+	};
+
+	enum {
+		moonCount = 14
+	};
+
 	static Config const cnf[count];
-	static bool modeSurvey;
+	static Moon const moons[moonCount];
 };
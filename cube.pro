@@ -1,6 +1,7 @@
-QT       += core gui widgets
+QT       += core gui widgets network
 
 CXX_FLAGS += -std=c++11
+CONFIG += c++11
 
 TARGET = cube
 TEMPLATE = app
@@ -8,7 +9,24 @@ TEMPLATE = app
 SOURCES += main.cpp \
     engine.cpp \
     config.cpp \
-    ephemeris.cpp
+    ephemeris.cpp \
+    keyframes.cpp \
+    profiler.cpp \
+    trace.cpp \
+    camera.cpp \
+    renderer.cpp \
+    benchmark.cpp \
+    offscreen.cpp \
+    camerapath.cpp \
+    encoder.cpp \
+    exporter.cpp \
+    renderserver.cpp \
+    parallel.cpp \
+    ephemerisserver.cpp \
+    resolution.cpp \
+    shadercache.cpp \
+    trails.cpp \
+    drawqueue.cpp
 
 qtHaveModule(opengl) {
     QT += opengl
@@ -32,4 +50,21 @@ simulator: warning(This example might not fully work on Simulator platform)
 HEADERS += \
     engine.h \
     config.h \
-    ephemeris.h
+    ephemeris.h \
+    keyframes.h \
+    profiler.h \
+    trace.h \
+    camera.h \
+    renderer.h \
+    benchmark.h \
+    offscreen.h \
+    camerapath.h \
+    encoder.h \
+    exporter.h \
+    renderserver.h \
+    parallel.h \
+    ephemerisserver.h \
+    resolution.h \
+    shadercache.h \
+    trails.h \
+    drawqueue.h
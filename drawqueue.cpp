@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <cstring>
+
+#include "drawqueue.h"
+#include "trace.h"
+
+FrameArena::FrameArena(std::size_t blockSize_)
+	:allocations(0),
+	blockSize(blockSize_),
+	current(0),
+	offset(0)
+{}
+
+void FrameArena::reset()
+{
+	current = 0;
+	offset = 0;
+	allocations = 0;
+}
+
+void *FrameArena::allocate(std::size_t bytes, std::size_t align)
+{
+	for (;;) {
+		if (current < blocks.size()) {
+			std::size_t start = (offset + align - 1) & ~(align - 1);
+			if (start + bytes <= blocks[current].size) {
+				offset = start + bytes;
+				return blocks[current].data.get() + start;
+			}
+			++current;
+			offset = 0;
+			continue;
+		}
+		std::size_t size = std::max(blockSize, bytes + align);
+		blocks.push_back(Block{std::unique_ptr<char[]>(new char[size]), size});
+		++allocations;
+	}
+}
+
+DrawQueue::DrawQueue()
+	:packets(0),
+	count(0),
+	capacity(0)
+{}
+
+void DrawQueue::begin(FrameArena &arena, int capacity_)
+{
+	capacity = capacity_;
+	count = 0;
+	packets = arena.allocate<DrawPacket>(capacity);
+}
+
+void DrawQueue::push(quint64 key, BaseEngine *body, QVector3D const &position)
+{
+	Q_ASSERT(count < capacity);
+	packets[count++] = DrawPacket{key, body, position};
+}
+
+quint64 DrawQueue::makeKey(int pass, int program, unsigned texture, unsigned mesh, float depth)
+{
+	// Non-negative floats order the same as their bit patterns. The sign
+	// bit is always clear and the lowest mantissa bits are dropped, which
+	// still tells distances apart to about 1e-5
+	quint32 depthBits;
+	std::memcpy(&depthBits, &depth, sizeof(depthBits));
+	return quint64(pass & 0xf) << 60
+		| quint64(program & 0xf) << 56
+		| quint64(depthBits >> 7 & 0xffffff) << 32
+		| quint64(texture & 0xffff) << 16
+		| (mesh & 0xffff);
+}
+
+int DrawQueue::keyPass(quint64 key)
+{
+	return key >> 60;
+}
+
+int DrawQueue::keyProgram(quint64 key)
+{
+	return (key >> 56) & 0xf;
+}
+
+void DrawQueue::sort(FrameArena &arena)
+{
+	TRACE_ZONE("DrawQueue::sort");
+	if (count < 2)
+		return;
+
+	// LSD radix sort a byte at a time, skipping bytes all keys share
+	DrawPacket *from = packets;
+	DrawPacket *to = arena.allocate<DrawPacket>(count);
+	for (int shift = 0; shift < 64; shift += 8) {
+		int histogram[256] = {0};
+		for (int idx = 0; idx < count; ++idx)
+			++histogram[(from[idx].key >> shift) & 0xff];
+		if (histogram[(from[0].key >> shift) & 0xff] == count)
+			continue;
+
+		int offset = 0;
+		for (int digit = 0; digit < 256; ++digit) {
+			int size = histogram[digit];
+			histogram[digit] = offset;
+			offset += size;
+		}
+		for (int idx = 0; idx < count; ++idx)
+			to[histogram[(from[idx].key >> shift) & 0xff]++] = from[idx];
+		std::swap(from, to);
+	}
+	packets = from;
+}
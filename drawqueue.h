@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QVector3D>
+#include <QtGlobal>
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+struct BaseEngine;
+
+// Linear allocator for data that lives for one frame. reset() rewinds it
+// without freeing, so once the blocks are big enough a frame allocates
+// nothing from the heap
+struct FrameArena
+{
+	explicit FrameArena(std::size_t blockSize = 64 * 1024);
+	void reset();
+	void *allocate(std::size_t bytes, std::size_t align);
+
+	template <typename T>
+	T *allocate(int count)
+	{
+		return static_cast<T *>(allocate(count * sizeof(T), alignof(T)));
+	}
+
+	// Heap allocations since the last reset
+	int allocations;
+
+private:
+	struct Block
+	{
+		std::unique_ptr<char[]> data;
+		std::size_t size;
+	};
+
+	std::vector<Block> blocks;
+	std::size_t blockSize;
+	std::size_t current;
+	std::size_t offset;
+};
+
+// One body to draw: everything submission needs besides the GL state
+// selected by the key
+struct DrawPacket
+{
+	quint64 key;
+	BaseEngine *body;
+	QVector3D position;
+};
+
+// Draw packets of one view, radix sorted by key so that submission walks
+// passes in order, changes program as rarely as possible and draws nearest
+// first within a program. Texture and mesh sit below the depth so they
+// only group packets at the same quantized depth; above it they would
+// undo the front to back order, as every planet has its own of both
+struct DrawQueue
+{
+	DrawQueue();
+	void begin(FrameArena &arena, int capacity);
+	void push(quint64 key, BaseEngine *body, QVector3D const &position);
+	void sort(FrameArena &arena);
+
+	// pass:4 program:4 depth:24 texture:16 mesh:16, most significant first
+	static quint64 makeKey(int pass, int program, unsigned texture, unsigned mesh, float depth);
+	static int keyPass(quint64 key);
+	static int keyProgram(quint64 key);
+
+	DrawPacket *packets;
+	int count;
+	int capacity;
+};
@@ -0,0 +1,81 @@
+#include <QElapsedTimer>
+
+#include <algorithm>
+
+#include "encoder.h"
+#include "trace.h"
+
+EncoderPool::EncoderPool(Job job_, int threads, int capacity_)
+	:stallMs(0),
+	job(job_),
+	capacity(std::max(1, capacity_)),
+	pending(0),
+	done(false)
+{
+	for (int idx = 0; idx < std::max(1, threads); ++idx)
+		workers.push_back(std::thread(&EncoderPool::work, this));
+}
+
+EncoderPool::~EncoderPool()
+{
+	finish();
+}
+
+void EncoderPool::submit(int index, QImage const &image)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	if (queue.size() >= capacity) {
+		QElapsedTimer timer;
+		timer.start();
+		changed.wait(lock, [this] { return queue.size() < capacity; });
+		stallMs += timer.nsecsElapsed() / 1e6;
+	}
+	queue.push_back(Frame{index, image});
+	++pending;
+	changed.notify_all();
+}
+
+void EncoderPool::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	changed.wait(lock, [this] { return pending == 0; });
+}
+
+void EncoderPool::finish()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		done = true;
+	}
+	changed.notify_all();
+	for (auto &worker : workers)
+		worker.join();
+	workers.clear();
+}
+
+void EncoderPool::work()
+{
+	for (;;) {
+		Frame frame;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [this] { return done || !queue.empty(); });
+			if (queue.empty())
+				return;
+			frame = queue.front();
+			queue.pop_front();
+		}
+		changed.notify_all();
+
+		{
+			TRACE_ZONE("EncoderPool::job");
+			job(frame.index, frame.image);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			--pending;
+		}
+		changed.notify_all();
+	}
+}
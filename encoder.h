@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QImage>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Worker threads encoding rendered frames. Frames are picked up in
+// submission order, so a single thread also finishes them in order. The
+// queue is bounded: submit() blocks while it is full, so memory stays flat
+// when encoding is slower than rendering.
+struct EncoderPool
+{
+	typedef std::function<void(int index, QImage const &image)> Job;
+
+	EncoderPool(Job job_, int threads, int capacity_);
+	~EncoderPool();
+
+	void submit(int index, QImage const &image);
+	// Blocks until every submitted frame is encoded, the workers stay up
+	void wait();
+	void finish();
+
+	// Time submit() spent waiting for a free slot
+	double stallMs;
+
+private:
+	struct Frame
+	{
+		int index;
+		QImage image;
+	};
+
+	void work();
+
+	Job const job;
+	size_t const capacity;
+	std::deque<Frame> queue;
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::vector<std::thread> workers;
+	int pending;
+	bool done;
+};
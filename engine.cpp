@@ -1,6 +1,13 @@
 #include "engine.h"
+#include "profiler.h"
+#include "trace.h"
 
-void BaseEngine::init(QGLWidget *that, QImage const &texture)
+BaseEngine::BaseEngine()
+	:parent(0),
+	dirty(true)
+{}
+
+void BaseEngine::init(QGLContext *that, QImage const &texture)
 {
     // qDebug() << texture.size();
 
@@ -28,7 +35,10 @@ void BaseEngine::init(QGLWidget *that, QImage const &texture)
 	// init texture
 	glEnable(GL_TEXTURE_2D);
 
-	textureIdx = that->bindTexture(texture);
+	{
+		TRACE_ZONE("bindTexture");
+		textureIdx = that->bindTexture(texture);
+	}
 
 	// Set nearest filtering mode for texture minification
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -42,53 +52,108 @@ void BaseEngine::init(QGLWidget *that, QImage const &texture)
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 }
 
-void BaseEngine::draw(QGLShaderProgram &program, QMatrix4x4 const &stateProjection, QVector3D const &stateCameraPosition)
+void ProgramLocations::resolve(QGLShaderProgram &program)
+{
+	position = program.attributeLocation("a_position");
+	texcoord = program.attributeLocation("a_texcoord");
+	normal = program.attributeLocation("a_normcoord");
+	projectionModelView = program.uniformLocation("projection_model_view_matrix");
+	modelView = program.uniformLocation("model_view_matrix");
+	normalMatrix = program.uniformLocation("normal_matrix");
+	texture = program.uniformLocation("texture");
+	eyePos = program.uniformLocation("eyePos");
+	lightPos = program.uniformLocation("lightPos");
+}
+
+void BaseEngine::bindMesh(ProgramLocations const &locations)
 {
 	// Tell OpenGL which VBOs to use
 	glBindBuffer(GL_ARRAY_BUFFER, vboIds[0]);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vboIds[1]);
-	
 
-	QMatrix4x4 matrix;
-    matrix.translate(statePosition - stateCameraPosition);
-    matrix.rotate(stateRotation);
+	// Position, then texture coordinate, then normal
+	int const attributes[] = {locations.position, locations.texcoord, locations.normal};
+	int const sizes[] = {3, 2, 3};
+	quintptr offset = 0;
+	for (int idx = 0; idx < 3; ++idx) {
+		if (attributes[idx] >= 0) {
+			glEnableVertexAttribArray(attributes[idx]);
+			glVertexAttribPointer(attributes[idx], sizes[idx], GL_FLOAT, GL_FALSE, sizeof(VertexData), (void const *)offset);
+		}
+		offset += sizes[idx] * sizeof(float);
+	}
+}
 
-	QMatrix4x4 normalMatrix;
-    normalMatrix.rotate(stateRotation);
+void BaseEngine::bindTexture()
+{
+	glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, textureIdx);
+	++Profiler::counters.textureBinds;
+}
 
-	program.setUniformValue("projection_model_view_matrix", stateProjection * matrix);
-	program.setUniformValue("model_view_matrix", matrix);
-	program.setUniformValue("normal_matrix", normalMatrix);
+void BaseEngine::drawMesh(QGLShaderProgram &program, ProgramLocations const &locations, QMatrix4x4 const &stateProjection, QVector3D const &stateCameraPosition, QVector3D const &position)
+{
+	TRACE_ZONE("BaseEngine::drawMesh");
+	QMatrix4x4 matrix;
+	matrix.translate(position - stateCameraPosition);
+	matrix *= worldRotation;
 
-	// Offset for position
-	quintptr offset = 0;
+	program.setUniformValue(locations.projectionModelView, stateProjection * matrix);
+	program.setUniformValue(locations.modelView, matrix);
+	program.setUniformValue(locations.normalMatrix, worldRotation);
 
-	// Tell OpenGL programmable pipeline how to locate vertex position data
-	int vertexLocation = program.attributeLocation("a_position");
-	program.enableAttributeArray(vertexLocation);
-	glVertexAttribPointer(vertexLocation, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void const *)offset);
+	// Draw cube geometry using indices from VBO 1
+	// glDrawElements(GL_TRIANGLE_STRIP, 34, GL_UNSIGNED_SHORT, 0);
+    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_SHORT, 0);
 
-	// Offset for texture coordinate
-	offset += sizeof(QVector3D);
+	++Profiler::counters.drawCalls;
+	Profiler::counters.triangles += indices.size() / 3;
+}
 
-	// Tell OpenGL programmable pipeline how to locate vertex texture coordinate data
-	int texcoordLocation = program.attributeLocation("a_texcoord");
-	program.enableAttributeArray(texcoordLocation);
-	glVertexAttribPointer(texcoordLocation, 2, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void const *)offset);
+void BaseEngine::unbindMesh(ProgramLocations const &locations)
+{
+	if (locations.texcoord >= 0)
+		glDisableVertexAttribArray(locations.texcoord);
+	if (locations.normal >= 0)
+		glDisableVertexAttribArray(locations.normal);
+}
 
-	offset += sizeof(QVector2D);
-	int normalLocation = program.attributeLocation("a_normcoord");
-	program.enableAttributeArray(normalLocation);
-	glVertexAttribPointer(normalLocation, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void const *)offset);
+void BaseEngine::attach(BaseEngine *child)
+{
+	child->parent = this;
+	child->dirty = true;
+	children.push_back(child);
+}
 
-	// Set texture
-	glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, textureIdx);
-	program.setUniformValue("texture", 0);
+void BaseEngine::setPosition(QVector3D const &position)
+{
+	if (position != statePosition) {
+		statePosition = position;
+		dirty = true;
+	}
+}
 
-	// Draw cube geometry using indices from VBO 1
-	// glDrawElements(GL_TRIANGLE_STRIP, 34, GL_UNSIGNED_SHORT, 0);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_SHORT, 0);
+void BaseEngine::setRotation(QQuaternion const &rotation)
+{
+	if (rotation != stateRotation) {
+		stateRotation = rotation;
+		dirty = true;
+	}
+}
+
+void BaseEngine::updateTransform(bool parentDirty)
+{
+	bool recompute = dirty || parentDirty;
+	if (recompute) {
+		worldPosition = statePosition;
+		if (parent)
+			worldPosition += parent->worldPosition;
+		worldRotation.setToIdentity();
+		worldRotation.rotate(stateRotation);
+		dirty = false;
+	}
+	for (auto child : children)
+		child->updateTransform(recompute);
 }
 
 SphereEngine::SphereEngine(float radius_, bool inverted_, int count_)
@@ -128,16 +193,25 @@ void SphereEngine::initGeometry()
 	}
 }
 
-PlanetEngine::PlanetEngine(QGLWidget *that_, PlanetConfig::Config const &cnf_)
-	: SphereEngine(cnf_.initial_inner_rad / 149597870.691)
+PlanetEngine::PlanetEngine(QGLContext *that_, PlanetConfig::Config const &cnf_, QImage const &texture, int count_)
+	: SphereEngine(cnf_.initial_inner_rad / 149597870.691, false, count_)
 {
 	impl.reset(new PlanetImpl(cnf_));
-	init(that_, QImage(":/" + cnf_.name));
+	keyframes.reset(new KeyframeCache(*impl));
+	init(that_, texture);
 	changeTime(QDateTime::currentDateTimeUtc());
 }
 
+QVector3D PlanetEngine::viewPosition(bool survey) const
+{
+	return survey ? worldPosition * surveyScale : worldPosition;
+}
+
 void PlanetEngine::changeTime(QDateTime const &newTime)
 {
-    statePosition = impl->getPosition(newTime);
-	stateRotation = QQuaternion::fromAxisAndAngle(0, 1, 0, impl->getRotationAngle(newTime));
+	TRACE_ZONE("PlanetEngine::changeTime");
+	double jdn = impl->toJulianDay(newTime);
+	setPosition(keyframes->getPosition(jdn));
+	surveyScale = impl->getSurveyScale(jdn);
+	setRotation(QQuaternion::fromAxisAndAngle(0, 1, 0, impl->getRotationAngle(newTime)));
 }
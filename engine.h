@@ -10,19 +10,54 @@
 #include <cmath>
 
 #include "ephemeris.h"
+#include "keyframes.h"
+
+// Attribute and uniform locations of a program, looked up once instead of
+// by name on every draw
+struct ProgramLocations
+{
+	void resolve(QGLShaderProgram &program);
+
+	int position;
+	int texcoord;
+	int normal;
+	int projectionModelView;
+	int modelView;
+	int normalMatrix;
+	int texture;
+	// Lighting, -1 in unlit programs
+	int eyePos;
+	int lightPos;
+};
 
 struct BaseEngine : public QGLFunctions
 {
+	BaseEngine();
+
 	struct VertexData
 	{
 		QVector3D position;
 		QVector2D texCoord;
 		QVector3D normal;
 	};
-	void init(QGLWidget *that, QImage const &texture);
-	void draw(QGLShaderProgram &program, QMatrix4x4 const &stateProjection, QVector3D const &stateCameraPosition);
+	void init(QGLContext *that, QImage const &texture);
+
+	// draw() in pieces for sorted submission, where the caller keeps track
+	// of the bound program, mesh and texture
+	void bindMesh(ProgramLocations const &locations);
+	void bindTexture();
+	void drawMesh(QGLShaderProgram &program, ProgramLocations const &locations, QMatrix4x4 const &stateProjection, QVector3D const &stateCameraPosition, QVector3D const &position);
+	// Programs drawn next may read fewer attributes than a mesh has
+	void unbindMesh(ProgramLocations const &locations);
     virtual void initGeometry() = 0;
 
+	// Scene graph: children inherit the parent's world position (but not
+	// its spin), world transforms are only rebuilt for dirty subtrees
+	void attach(BaseEngine *child);
+	void setPosition(QVector3D const &position);
+	void setRotation(QQuaternion const &rotation);
+	void updateTransform(bool parentDirty = false);
+
 	std::vector<VertexData> vertices;
 	std::vector<GLushort> indices;
 	GLuint vboIds[2];
@@ -30,6 +65,12 @@ struct BaseEngine : public QGLFunctions
 
     QQuaternion stateRotation;
     QVector3D statePosition;
+
+	BaseEngine *parent;
+	std::vector<BaseEngine *> children;
+	bool dirty;
+	QVector3D worldPosition;
+	QMatrix4x4 worldRotation;
 };
 
 struct SphereEngine : public BaseEngine
@@ -44,8 +85,12 @@ struct SphereEngine : public BaseEngine
 
 struct PlanetEngine : public SphereEngine
 {
-	PlanetEngine(QGLWidget *that_, PlanetConfig::Config const &cnf_);
+	PlanetEngine(QGLContext *that_, PlanetConfig::Config const &cnf_, QImage const &texture, int count_=30);
 	void changeTime(QDateTime const &newTime);
+	QVector3D viewPosition(bool survey) const;
 
+	// Survey mode position is the true one times this
+	float surveyScale;
     std::unique_ptr<PlanetImpl> impl;
+	std::unique_ptr<KeyframeCache> keyframes;
 };
@@ -1,6 +1,7 @@
 #include <cmath>
 
 #include "ephemeris.h"
+#include "trace.h"
 
 PlanetImpl::PlanetImpl(PlanetConfig::Config const &c)
 {
@@ -22,6 +23,13 @@ PlanetImpl::PlanetImpl(PlanetConfig::Config const &c)
 }
 
 QVector3D PlanetImpl::getEllipsePos(const Orbit &eph, double M)
+{
+	double position[3];
+	getEllipsePos(eph, M, position);
+	return QVector3D(position[0], position[1], position[2]);
+}
+
+void PlanetImpl::getEllipsePos(const Orbit &eph, double M, double position[3])
 {
 	double w = eph.w - eph.W;
 	double I = eph.i;
@@ -31,11 +39,8 @@ QVector3D PlanetImpl::getEllipsePos(const Orbit &eph, double M)
 		oE = E;
 		E = M + eph.e * std::sin(E);
 	}
-	double eph_a = eph.a;
-	if (PlanetConfig::modeSurvey)
-		eph_a = std::log(1.0 + eph.a) / 1e3;
-	double x = eph_a * (std::cos(E) - eph.e);
-	double y = eph_a * std::sqrt(1 - eph.e * eph.e) * std::sin(E);
+	double x = eph.a * (std::cos(E) - eph.e);
+	double y = eph.a * std::sqrt(1 - eph.e * eph.e) * std::sin(E);
 	double sO = std::sin(eph.W);
 	double cO = std::cos(eph.W);
 	double sw = std::sin(w);
@@ -49,7 +54,9 @@ QVector3D PlanetImpl::getEllipsePos(const Orbit &eph, double M)
 	double X  = (cc - ss * ci) * x + (-sc - cs * ci) * y;
 	double Y  = (std::sin(w) * si) * x + (std::cos(w) * si) * y;
 	double Z  = -(cs + sc * ci) * x - (-ss + cc * ci) * y;
-    return QVector3D(X, Y, Z);
+	position[0] = X;
+	position[1] = Y;
+	position[2] = Z;
 }
 
 double PlanetImpl::getEphemerisValue(double jdn, double initial, double rate_per_century)
@@ -81,15 +88,49 @@ double PlanetImpl::toJulianDay(const QDateTime &date)
 
 QVector3D PlanetImpl::getPosition(const QDateTime &date)
 {
-	auto eph = getEphemeris(toJulianDay(date));
+	return getPosition(toJulianDay(date));
+}
+
+QVector3D PlanetImpl::getPosition(double jdn)
+{
+	double position[3];
+	getPosition(jdn, position);
+	return QVector3D(position[0], position[1], position[2]);
+}
+
+void PlanetImpl::getPosition(double jdn, double position[3])
+{
+	TRACE_ZONE("PlanetImpl::getPosition");
+	auto eph = getEphemeris(jdn);
 	double M = eph.l - eph.w;
 	// Modulus the mean anomaly so that -180 < M < 180
 	double m = (M + M_PI) / (2.0 * M_PI);
 	M = (m - std::floor(m)) * 2.0 * M_PI - M_PI;
-	return getEllipsePos(eph, M);
+	getEllipsePos(eph, M, position);
 }
 
 double PlanetImpl::getRotationAngle(const QDateTime &time)
 {
-	return -time.msecsTo(QDateTime(QDate(2000, 1, 1), QTime(0, 0))) / (1000.0 * 60.0 * 60.0 * 24.0 / 360.0) / _rotation_period;
+	// Through the julian day, so the epoch is the same UTC midnight
+	return getRotationAngle(toJulianDay(time));
+}
+
+double PlanetImpl::getRotationAngle(double jdn)
+{
+	// Days since 2000-01-01 00:00
+	return (jdn - 2451545.0) * 360.0 / _rotation_period;
+}
+
+double PlanetImpl::getSurveyScale(double jdn)
+{
+	// Survey mode squeezes the semi-major axis to log(1 + a) / 1000, and
+	// the position is linear in a
+	double a = getEphemerisValue(jdn, orbitInit.a, _delta_orbit.a);
+	return std::log(1.0 + a) / 1e3 / a;
+}
+
+double PlanetImpl::getOrbitalPeriod()
+{
+	// Mean longitude rate is in degrees per julian century
+	return 360.0 * 36525.0 / std::abs(_delta_orbit.l);
 }
@@ -9,7 +9,13 @@ struct PlanetImpl
 {
 	PlanetImpl(PlanetConfig::Config const &c);
 	QVector3D getPosition(QDateTime const &date);
+	QVector3D getPosition(double jdn);
+	// Same without rounding to float, for callers that difference positions
+	void getPosition(double jdn, double position[3]);
 	double getRotationAngle(QDateTime const &time);
+	double getRotationAngle(double jdn);
+	double getOrbitalPeriod();
+	double getSurveyScale(double jdn);
 
 	struct Orbit
 	{
@@ -27,6 +33,7 @@ struct PlanetImpl
 	double _radius;
 	double _rotation_period;
 	QVector3D getEllipsePos(Orbit const &eph, double m);
+	void getEllipsePos(Orbit const &eph, double m, double position[3]);
     Orbit getEphemeris(double date);
 	double toJulianDay(QDateTime const &date);
 	double getEphemerisValue(double jdn, double initial, double rate_per_century);
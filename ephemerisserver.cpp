@@ -0,0 +1,210 @@
+#include <QElapsedTimer>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+
+#include "ephemerisserver.h"
+#include "trace.h"
+
+EphemerisServer::EphemerisServer(QString const &name_, int threads, double tableYears_)
+	:name(name_),
+	tableYears(tableYears_),
+	pool(std::max(0, threads - 1)),
+	queries(0)
+{
+	for (int idx = 0; idx < PlanetConfig::count; ++idx) {
+		bodies.push_back(std::unique_ptr<PlanetImpl>(new PlanetImpl(PlanetConfig::cnf[idx])));
+		parents.push_back(-1);
+	}
+	for (int idx = 0; idx < PlanetConfig::moonCount; ++idx) {
+		bodies.push_back(std::unique_ptr<PlanetImpl>(new PlanetImpl(PlanetConfig::moons[idx].cnf)));
+		parents.push_back(PlanetConfig::moons[idx].parent);
+	}
+	tables.resize(bodies.size());
+}
+
+bool EphemerisServer::start()
+{
+	if (tableYears > 0) {
+		QElapsedTimer timer;
+		timer.start();
+		PlanetImpl &any = *bodies.front();
+		double now = any.toJulianDay(QDateTime::currentDateTimeUtc());
+		double span = tableYears * 365.25;
+		size_t memory = 0;
+		pool.run(bodies.size(), [&](int body) {
+			tables[body].reset(new EphemerisTable(*bodies[body], now - span, now + span));
+		});
+		for (auto const &table : tables)
+			memory += table->positions.size() * sizeof(QVector3D);
+		qDebug() << "ephemeris: tables for +-" << tableYears << "years," << memory << "bytes in" << timer.elapsed() << "ms";
+	}
+
+	QLocalServer::removeServer(name);
+	if (!server.listen(name)) {
+		qWarning() << "ephemeris:" << server.errorString();
+		return false;
+	}
+	connect(&server, &QLocalServer::newConnection, [this] {
+		while (QLocalSocket *socket = server.nextPendingConnection()) {
+			connect(socket, &QLocalSocket::readyRead, [this, socket] { serve(socket); });
+			connect(socket, &QLocalSocket::disconnected, [this, socket] {
+				buffers.erase(socket);
+				socket->deleteLater();
+			});
+		}
+	});
+	connect(&reportTimer, &QTimer::timeout, [this] { report(); });
+	reportTimer.start(5000);
+	qDebug() << "ephemeris: listening on" << server.fullServerName();
+	return true;
+}
+
+namespace {
+
+quint32 readWord(char const *data, int offset)
+{
+	return qFromLittleEndian<quint32>(reinterpret_cast<uchar const *>(data + offset));
+}
+
+double readDouble(char const *data, int offset)
+{
+	quint64 bits = qFromLittleEndian<quint64>(reinterpret_cast<uchar const *>(data + offset));
+	double value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+void writeWord(quint32 value, char *data, int offset)
+{
+	qToLittleEndian<quint32>(value, reinterpret_cast<uchar *>(data + offset));
+}
+
+void writeDouble(double value, char *data, int offset)
+{
+	quint64 bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	qToLittleEndian<quint64>(bits, reinterpret_cast<uchar *>(data + offset));
+}
+
+}
+
+void EphemerisServer::localPosition(int body, double jdn, bool useTables, double position[3])
+{
+	EphemerisTable const *table = tables[body].get();
+	if (useTables && table && table->covers(jdn)) {
+		QVector3D tabulated = table->getPosition(jdn);
+		for (int axis = 0; axis < 3; ++axis)
+			position[axis] = tabulated[axis];
+		return;
+	}
+	bodies[body]->getPosition(jdn, position);
+}
+
+void EphemerisServer::velocity(int body, double jdn, double result[3])
+{
+	// Central difference in double over a tenth of a degree of the orbit,
+	// its truncation error is far below the float positions of the tables
+	// so they are never used here. Moons are differentiated relative to
+	// their planet.
+	double h = bodies[body]->getOrbitalPeriod() / 3600;
+	double ahead[3], behind[3];
+	bodies[body]->getPosition(jdn + h, ahead);
+	bodies[body]->getPosition(jdn - h, behind);
+	for (int axis = 0; axis < 3; ++axis)
+		result[axis] = (ahead[axis] - behind[axis]) / (2 * h);
+	if (parents[body] >= 0) {
+		double parent[3];
+		velocity(parents[body], jdn, parent);
+		for (int axis = 0; axis < 3; ++axis)
+			result[axis] += parent[axis];
+	}
+}
+
+void EphemerisServer::evaluate(Query const &query, State &state, bool useTables)
+{
+	if (query.body >= bodies.size()) {
+		std::memset(&state, 0, sizeof(state));
+		return;
+	}
+	int body = query.body;
+	localPosition(body, query.jdn, useTables, state.position);
+	if (parents[body] >= 0) {
+		double parent[3];
+		localPosition(parents[body], query.jdn, useTables, parent);
+		for (int axis = 0; axis < 3; ++axis)
+			state.position[axis] += parent[axis];
+	}
+	velocity(body, query.jdn, state.velocity);
+	state.rotation = bodies[body]->getRotationAngle(query.jdn);
+}
+
+void EphemerisServer::serve(QLocalSocket *socket)
+{
+	TRACE_ZONE("EphemerisServer::serve");
+	QByteArray &buffer = buffers[socket];
+	buffer += socket->readAll();
+
+	while (buffer.size() >= headerSize) {
+		Header header = {readWord(buffer.constData(), 0), readWord(buffer.constData(), 4),
+			readWord(buffer.constData(), 8), readWord(buffer.constData(), 12)};
+		if (header.magic != requestMagic || header.count > maxQueries) {
+			qWarning() << "ephemeris: bad request";
+			buffer.clear();
+			socket->disconnectFromServer();
+			return;
+		}
+		int size = headerSize + header.count * querySize;
+		if (buffer.size() < size)
+			return;
+
+		QElapsedTimer timer;
+		timer.start();
+
+		std::vector<Query> batch(header.count);
+		for (quint32 idx = 0; idx < header.count; ++idx) {
+			char const *record = buffer.constData() + headerSize + idx * querySize;
+			batch[idx].body = readWord(record, 0);
+			batch[idx].reserved = 0;
+			batch[idx].jdn = readDouble(record, 8);
+		}
+		buffer.remove(0, size);
+
+		std::vector<State> states(header.count);
+		bool useTables = header.flags & flagTables;
+		pool.run(header.count, [&](int idx) {
+			evaluate(batch[idx], states[idx], useTables);
+		}, 256);
+
+		QByteArray reply(headerSize + header.count * stateSize, 0);
+		writeWord(replyMagic, reply.data(), 0);
+		writeWord(header.count, reply.data(), 4);
+		for (quint32 idx = 0; idx < header.count; ++idx) {
+			char *record = reply.data() + headerSize + idx * stateSize;
+			for (int axis = 0; axis < 3; ++axis) {
+				writeDouble(states[idx].position[axis], record, axis * 8);
+				writeDouble(states[idx].velocity[axis], record, 24 + axis * 8);
+			}
+			writeDouble(states[idx].rotation, record, 48);
+		}
+		socket->write(reply);
+
+		latencies.push_back(timer.nsecsElapsed() / 1e3);
+		queries += header.count;
+	}
+}
+
+void EphemerisServer::report()
+{
+	if (latencies.empty())
+		return;
+	std::sort(latencies.begin(), latencies.end());
+	auto percentile = [this](double p) {
+		return latencies[static_cast<int>(p * (latencies.size() - 1))];
+	};
+	qDebug() << "ephemeris:" << latencies.size() << "requests," << queries << "queries, latency us p50"
+		<< percentile(.5) << "p90" << percentile(.9) << "p99" << percentile(.99) << "max" << latencies.back();
+	latencies.clear();
+	queries = 0;
+}
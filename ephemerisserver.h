@@ -0,0 +1,91 @@
+#pragma once
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTimer>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "keyframes.h"
+#include "parallel.h"
+
+// Position, velocity and rotation queries over a local socket. A request is
+// a Header with magic requestMagic followed by count Query records; the
+// reply is a Header with magic replyMagic followed by count State records
+// in the same order. The structs give the field order with no padding, and
+// every field is encoded little-endian whatever the host. Bodies are
+// numbered as PlanetConfig::cnf followed by PlanetConfig::moons; positions
+// are heliocentric in AU, velocities in AU per day, rotation in degrees.
+// Everything is evaluated in double, except that positions answered from
+// the tables (flagTables) carry their float precision, about 1e-7 of the
+// distance. Velocities always come from direct evaluation.
+class EphemerisServer : public QObject
+{
+	Q_OBJECT
+
+public:
+	enum {
+		requestMagic = 0x51485045, // "EPHQ"
+		replyMagic = 0x52485045, // "EPHR"
+		// Answer from the precomputed tables where they cover the time
+		flagTables = 1,
+		maxQueries = 1 << 20
+	};
+
+	struct Header
+	{
+		quint32 magic;
+		quint32 count;
+		quint32 flags;
+		quint32 reserved;
+	};
+
+	struct Query
+	{
+		quint32 body;
+		quint32 reserved;
+		double jdn;
+	};
+
+	enum {
+		headerSize = 16,
+		querySize = 16,
+		stateSize = 56
+	};
+
+	struct State
+	{
+		double position[3];
+		double velocity[3];
+		double rotation;
+	};
+
+	EphemerisServer(QString const &name_, int threads, double tableYears_);
+	bool start();
+
+private:
+	void serve(QLocalSocket *socket);
+	void evaluate(Query const &query, State &state, bool useTables);
+	void localPosition(int body, double jdn, bool useTables, double position[3]);
+	void velocity(int body, double jdn, double result[3]);
+	void report();
+
+	QString const name;
+	double const tableYears;
+	QLocalServer server;
+
+	std::vector<std::unique_ptr<PlanetImpl>> bodies;
+	// -1 for bodies orbiting the sun
+	std::vector<int> parents;
+	std::vector<std::unique_ptr<EphemerisTable>> tables;
+
+	ThreadPool pool;
+	std::map<QLocalSocket *, QByteArray> buffers;
+
+	// Microseconds per request since the last report
+	std::vector<double> latencies;
+	quint64 queries;
+	QTimer reportTimer;
+};
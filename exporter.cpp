@@ -0,0 +1,128 @@
+#include <QDir>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+
+#include "camerapath.h"
+#include "encoder.h"
+#include "exporter.h"
+#include "offscreen.h"
+#include "trace.h"
+
+Exporter::Exporter(QString const &outputDir_, QString const &pipeCommand_, QSize const &size_, int frames_,
+	qint64 step_, QDateTime const &start_, QString const &pathName_, int threads_)
+	:outputDir(outputDir_),
+	pipeCommand(pipeCommand_),
+	size(size_),
+	frames(frames_),
+	step(step_),
+	start(start_),
+	pathName(pathName_),
+	threads(threads_)
+{}
+
+int Exporter::run()
+{
+	CameraPath path = findCameraPath(pathName);
+	if (!path) {
+		qWarning() << "export: unknown camera path" << pathName;
+		return 1;
+	}
+
+	OffscreenTarget target(size);
+	if (!target.init())
+		return 1;
+
+	Renderer renderer;
+	if (!renderer.init(target.glContext()))
+		return 1;
+	glViewport(0, 0, size.width(), size.height());
+
+	// Set by a job that could not write its frame, rendering stops early
+	std::atomic<bool> failed(false);
+	FILE *pipe = 0;
+	EncoderPool::Job job;
+	int workers = threads;
+	if (!pipeCommand.isEmpty()) {
+#ifdef SIGPIPE
+		// An encoder that exits early shows up as a short write instead
+		signal(SIGPIPE, SIG_IGN);
+#endif
+		pipe = popen(pipeCommand.toLocal8Bit().constData(), "w");
+		if (!pipe) {
+			qWarning() << "export: could not start" << pipeCommand;
+			return 1;
+		}
+		// Raw RGBA frames, one writer keeps them in order. Rows go out
+		// bottom up, which flips the GL image without a copy
+		job = [pipe, &failed](int index, QImage const &image) {
+			if (failed.load())
+				return;
+			size_t rowBytes = image.width() * 4;
+			for (int y = image.height() - 1; y >= 0; --y)
+				if (fwrite(image.constScanLine(y), 1, rowBytes, pipe) != rowBytes) {
+					qWarning() << "export: encoder stopped reading at frame" << index;
+					failed.store(true);
+					return;
+				}
+		};
+		workers = 1;
+	} else {
+		QDir().mkpath(outputDir);
+		QDir dir(outputDir);
+		job = [dir, &failed](int index, QImage const &image) {
+			if (failed.load())
+				return;
+			QString file = dir.filePath(QString("frame%1.png").arg(index, 6, 10, QChar('0')));
+			if (!image.mirrored().save(file)) {
+				qWarning() << "export: could not write" << file;
+				failed.store(true);
+			}
+		};
+	}
+	EncoderPool pool(job, workers, workers * 4);
+
+	ReadbackRing ring;
+	auto collect = [&](int frame) {
+		TRACE_ZONE("Exporter::collect");
+		pool.submit(frame, ring.take(frame));
+	};
+
+	QElapsedTimer timer;
+	timer.start();
+	Camera camera;
+	camera.aspect = qreal(size.width()) / size.height();
+	camera.survey = pathName == "survey";
+	for (int frame = 0; frame < frames && !failed.load(); ++frame) {
+		renderer.changeTime(start.addMSecs(step * 1000 * frame));
+		path(renderer, camera, frames > 1 ? double(frame) / (frames - 1) : 0);
+		renderer.update(camera);
+		renderer.render(camera);
+
+		ring.read(frame, size);
+		if (frame >= ReadbackRing::depth - 1)
+			collect(frame - (ReadbackRing::depth - 1));
+	}
+	for (int frame = std::max(0, frames - (ReadbackRing::depth - 1)); frame < frames && !failed.load(); ++frame)
+		collect(frame);
+	double renderMs = timer.nsecsElapsed() / 1e6;
+
+	pool.finish();
+	if (pipe && pclose(pipe) != 0 && !failed.load()) {
+		qWarning() << "export: encoder exited with an error";
+		failed.store(true);
+	}
+	double totalMs = timer.nsecsElapsed() / 1e6;
+
+	if (failed.load()) {
+		qWarning() << "export: aborted";
+		return 1;
+	}
+
+	qDebug() << "export:" << frames << "frames," << frames * 1000.0 / totalMs << "fps sustained,"
+		<< frames * 1000.0 / renderMs << "fps rendering," << pool.stallMs << "ms waiting for encoders";
+	return 0;
+}
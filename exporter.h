@@ -0,0 +1,24 @@
+#pragma once
+
+#include <QDateTime>
+#include <QSize>
+#include <QString>
+
+// Renders a scripted camera path at a fixed simulated timestep and streams
+// the frames to a PNG sequence or to the stdin of an encoder process
+struct Exporter
+{
+	Exporter(QString const &outputDir_, QString const &pipeCommand_, QSize const &size_, int frames_,
+		qint64 step_, QDateTime const &start_, QString const &pathName_, int threads_);
+	int run();
+
+	QString const outputDir;
+	QString const pipeCommand;
+	QSize const size;
+	int const frames;
+	// Simulated seconds per frame
+	qint64 const step;
+	QDateTime const start;
+	QString const pathName;
+	int const threads;
+};
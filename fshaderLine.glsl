@@ -0,0 +1,14 @@
+#ifdef GL_ES
+// Set default precision to medium
+precision mediump int;
+precision mediump float;
+#endif
+
+uniform vec4 color;
+
+//! [0]
+void main()
+{
+    gl_FragColor = color;
+}
+//! [0]
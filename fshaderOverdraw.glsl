@@ -0,0 +1,13 @@
+#ifdef GL_ES
+// Set default precision to medium
+precision mediump int;
+precision mediump float;
+#endif
+
+//! [0]
+void main()
+{
+    // Added once per shaded fragment, brighter pixels were shaded more times
+    gl_FragColor = vec4(0.125, 0.0625, 0.03125, 1.0);
+}
+//! [0]
@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "keyframes.h"
+
+static qint64 const emptySlot = std::numeric_limits<qint64>::min();
+
+// Catmull-Rom spline through p1..p2
+QVector3D catmullRom(QVector3D const &p0, QVector3D const &p1, QVector3D const &p2, QVector3D const &p3, float t)
+{
+	return 0.5f * (2 * p1
+		+ (p2 - p0) * t
+		+ (2 * p0 - 5 * p1 + 4 * p2 - p3) * t * t
+		+ (3 * p1 - p0 - 3 * p2 + p3) * t * t * t);
+}
+
+int adaptiveSamplesPerOrbit(PlanetImpl &impl)
+{
+	// Catmull-Rom is only second order accurate: on a circle of radius r it
+	// misses by about 4 r / n^3 with n samples per orbit. At perihelion the
+	// body moves faster than the mean motion by (1 + e)^2 / (1 - e^2)^1.5,
+	// which shortens the orbit in samples
+	double a = impl.orbitInit.a;
+	double e = impl.orbitInit.e;
+	double speedup = (1 + e) * (1 + e) / std::pow(1 - e * e, 1.5);
+	double samples = speedup * std::cbrt(4 * a * (1 - e) / keyframeTolerance);
+	return std::min(4096, std::max(64, static_cast<int>(std::ceil(samples))));
+}
+
+static double keyframeStep(PlanetImpl &impl, int samplesPerOrbit)
+{
+	return impl.getOrbitalPeriod() / (samplesPerOrbit ? samplesPerOrbit : adaptiveSamplesPerOrbit(impl));
+}
+
+KeyframeCache::KeyframeCache(PlanetImpl &impl_, int capacity_, int samplesPerOrbit)
+	:impl(impl_),
+	step(keyframeStep(impl_, samplesPerOrbit)),
+	frames(capacity_),
+	hits(0),
+	misses(0)
+{
+	clear();
+}
+
+void KeyframeCache::clear()
+{
+	for (auto &frame : frames)
+		frame.slot = emptySlot;
+}
+
+QVector3D const &KeyframeCache::getKeyframe(qint64 slot)
+{
+	qint64 size = frames.size();
+	Keyframe &frame = frames[((slot % size) + size) % size];
+	if (frame.slot == slot) {
+		++hits;
+	} else {
+		++misses;
+		frame.slot = slot;
+		frame.position = impl.getPosition(slot * step);
+	}
+	return frame.position;
+}
+
+QVector3D KeyframeCache::getPosition(double jdn)
+{
+	double s = jdn / step;
+	qint64 slot = static_cast<qint64>(std::floor(s));
+	float t = s - slot;
+
+	QVector3D p0 = getKeyframe(slot - 1);
+	QVector3D p1 = getKeyframe(slot);
+	QVector3D p2 = getKeyframe(slot + 1);
+	QVector3D p3 = getKeyframe(slot + 2);
+
+	return catmullRom(p0, p1, p2, p3, t);
+}
+
+size_t KeyframeCache::memoryUsage() const
+{
+	return frames.capacity() * sizeof(Keyframe);
+}
+
+double KeyframeCache::hitRate() const
+{
+	quint64 total = hits + misses;
+	return total ? double(hits) / total : 0;
+}
+
+EphemerisTable::EphemerisTable(PlanetImpl &impl, double from_, double to, int samplesPerOrbit)
+	:step(keyframeStep(impl, samplesPerOrbit)),
+	from(std::floor(from_ / step) * step - step)
+{
+	// One extra sample on each side for the spline
+	double count = std::ceil((to - from) / step) + 3;
+	// Fast inner moons over long ranges would take hundreds of megabytes,
+	// leave those to direct evaluation
+	if (count > (1 << 21))
+		return;
+	positions.reserve(count);
+	for (int idx = 0; idx < count; ++idx)
+		positions.push_back(impl.getPosition(from + idx * step));
+}
+
+bool EphemerisTable::covers(double jdn) const
+{
+	double s = (jdn - from) / step;
+	return s >= 1 && s < static_cast<int>(positions.size()) - 2;
+}
+
+QVector3D EphemerisTable::getPosition(double jdn) const
+{
+	double s = (jdn - from) / step;
+	int idx = static_cast<int>(std::floor(s));
+	return catmullRom(positions[idx - 1], positions[idx], positions[idx + 1], positions[idx + 2], s - idx);
+}
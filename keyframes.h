@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QVector3D>
+
+#include <vector>
+
+#include "ephemeris.h"
+
+QVector3D catmullRom(QVector3D const &p0, QVector3D const &p1, QVector3D const &p2, QVector3D const &p3, float t);
+
+// Samples per orbit that keep the Catmull-Rom error under keyframeTolerance
+// AU at perihelion: 311 to 358 for the inner planets, up to 1818 for Pluto,
+// which in time is still one sample per 0.25 days for Mercury against 50
+// for Pluto. The keyframes are floats, which adds a few ulps of the
+// distance from the sun on top of this, about 3e-7 of it
+int adaptiveSamplesPerOrbit(PlanetImpl &impl);
+
+double const keyframeTolerance = 1e-7;
+
+// Direct-mapped cache of body positions sampled at a fixed per-body step.
+// Positions between keyframes are Catmull-Rom interpolated, so playback,
+// seeking and scrubbing in either direction only evaluate the ephemeris
+// once per step instead of once per frame. Rotation is linear in time and
+// is evaluated directly, so it does not constrain the step.
+struct KeyframeCache
+{
+	// samplesPerOrbit 0 picks adaptiveSamplesPerOrbit()
+	KeyframeCache(PlanetImpl &impl_, int capacity_ = 512, int samplesPerOrbit = 0);
+	QVector3D getPosition(double jdn);
+	void clear();
+
+	size_t memoryUsage() const;
+	double hitRate() const;
+
+	struct Keyframe
+	{
+		qint64 slot;
+		QVector3D position;
+	};
+
+	QVector3D const &getKeyframe(qint64 slot);
+
+	PlanetImpl &impl;
+	double const step;
+	std::vector<Keyframe> frames;
+	quint64 hits;
+	quint64 misses;
+};
+
+// Positions precomputed over a fixed range at the same step as the cache.
+// Read-only after construction, so any number of threads may query it.
+struct EphemerisTable
+{
+	EphemerisTable(PlanetImpl &impl, double from_, double to, int samplesPerOrbit = 0);
+	bool covers(double jdn) const;
+	QVector3D getPosition(double jdn) const;
+
+	double const step;
+	double const from;
+	std::vector<QVector3D> positions;
+};
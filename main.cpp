@@ -39,23 +39,138 @@
 ****************************************************************************/
 
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QDebug>
 #include <QLabel>
 
+#include "trace.h"
+#include "ephemerisserver.h"
+
 #ifndef QT_NO_OPENGL
 #include "mainwidget.h"
+#include "benchmark.h"
+#include "exporter.h"
+#include "renderserver.h"
+#include "shadercache.h"
 #endif
 
+#include <algorithm>
+#include <memory>
+
+// Modes that never touch OpenGL or widgets run without a display
+static bool isHeadless(int argc, char *argv[])
+{
+    for (int idx = 1; idx < argc; ++idx)
+        if (!qstrcmp(argv[idx], "--ephemeris-server"))
+            return true;
+    return false;
+}
+
 int main(int argc, char *argv[])
 {
-    QApplication app(argc, argv);
+    std::unique_ptr<QCoreApplication> application(isHeadless(argc, argv)
+        ? new QCoreApplication(argc, argv)
+        : new QApplication(argc, argv));
+    QCoreApplication &app = *application;
     app.setApplicationName("cube");
     app.setApplicationVersion("0.1");
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption traceOption("trace", "Record trace zones from startup and write the last 10 seconds to <file> on exit.", "file");
+    parser.addOption(traceOption);
+    QCommandLineOption benchmarkOption("benchmark", "Render the benchmark scenarios offscreen and write the results to <dir>.", "dir");
+    parser.addOption(benchmarkOption);
+    QCommandLineOption exportOption("export", "Render a camera path at a fixed timestep and write a PNG sequence to <dir>.", "dir");
+    parser.addOption(exportOption);
+    QCommandLineOption exportPipeOption("export-pipe", "Pipe raw RGBA frames of the export to the stdin of <command>.", "command");
+    parser.addOption(exportPipeOption);
+    QCommandLineOption pathOption("path", "Camera path to export: orbit, flyto or survey.", "name", "flyto");
+    parser.addOption(pathOption);
+    QCommandLineOption stepOption("step", "Simulated seconds per exported frame.", "seconds", "3600");
+    parser.addOption(stepOption);
+    QCommandLineOption startOption("start", "Simulation start, ISO 8601 UTC.", "date", "2000-01-01T12:00:00Z");
+    parser.addOption(startOption);
+    QCommandLineOption threadsOption("threads", "Worker threads for encoding and ephemeris queries.", "count", "4");
+    parser.addOption(threadsOption);
+    QCommandLineOption serveOption("serve", "Serve snapshot requests on the local socket <name>.", "name");
+    parser.addOption(serveOption);
+    QCommandLineOption ephemerisServerOption("ephemeris-server", "Serve ephemeris queries on the local socket <name>.", "name");
+    parser.addOption(ephemerisServerOption);
+    QCommandLineOption tableYearsOption("table-years", "Precompute ephemeris tables for this many years around now.", "years", "0");
+    parser.addOption(tableYearsOption);
+    QCommandLineOption budgetOption("dynamic-resolution", "Scale the render resolution to hold a GPU frame time of <ms>.", "ms");
+    parser.addOption(budgetOption);
+    QCommandLineOption sizeOption("size", "Offscreen framebuffer size.", "WxH", "1280x720");
+    parser.addOption(sizeOption);
+    QCommandLineOption framesOption("frames", "Frames per benchmark scenario, or frames to export.", "count", "600");
+    parser.addOption(framesOption);
+    QCommandLineOption noShaderCacheOption("no-shader-cache", "Always compile shaders from source instead of loading cached program binaries.");
+    parser.addOption(noShaderCacheOption);
+    parser.process(app);
+
+    if (parser.isSet(traceOption))
+        Trace::enabled = true;
+#ifndef QT_NO_OPENGL
+    if (parser.isSet(noShaderCacheOption))
+        ShaderCache::enabled = false;
+#endif
+
+    if (parser.isSet(ephemerisServerOption)) {
+        EphemerisServer server(parser.value(ephemerisServerOption),
+            std::max(1, parser.value(threadsOption).toInt()), parser.value(tableYearsOption).toDouble());
+        if (!server.start())
+            return 1;
+        return app.exec();
+    }
+
+    QStringList size = parser.value(sizeOption).split('x');
+    QSize offscreenSize(size.value(0).toInt(), size.value(1).toInt());
+    if (offscreenSize.isEmpty())
+        offscreenSize = QSize(1280, 720);
+
 #ifndef QT_NO_OPENGL
+    if (parser.isSet(benchmarkOption)) {
+        Benchmark benchmark(parser.value(benchmarkOption), offscreenSize, std::max(1, parser.value(framesOption).toInt()));
+        int result = benchmark.run();
+        if (parser.isSet(traceOption))
+            Trace::dump(parser.value(traceOption));
+        return result;
+    }
+
+    if (parser.isSet(exportOption) || parser.isSet(exportPipeOption)) {
+        QDateTime start = QDateTime::fromString(parser.value(startOption), Qt::ISODate).toUTC();
+        if (!start.isValid()) {
+            qWarning() << "cube: --start is not an ISO 8601 date:" << parser.value(startOption);
+            parser.showHelp(1);
+        }
+        Exporter exporter(parser.value(exportOption), parser.value(exportPipeOption), offscreenSize,
+            std::max(1, parser.value(framesOption).toInt()), parser.value(stepOption).toLongLong(),
+            start, parser.value(pathOption), parser.value(threadsOption).toInt());
+        int result = exporter.run();
+        if (parser.isSet(traceOption))
+            Trace::dump(parser.value(traceOption));
+        return result;
+    }
+
+    if (parser.isSet(serveOption)) {
+        RenderServer server(parser.value(serveOption), std::max(1, parser.value(threadsOption).toInt()));
+        if (!server.start())
+            return 1;
+        return app.exec();
+    }
+
     MainWidget widget;
+    if (parser.isSet(budgetOption))
+        widget.setFrameBudget(parser.value(budgetOption).toDouble());
     widget.show();
 #else
     QLabel note("OpenGL Support required");
     note.show();
 #endif
-    return app.exec();
+    int result = app.exec();
+
+    if (parser.isSet(traceOption))
+        Trace::dump(parser.value(traceOption));
+    return result;
 }
@@ -1,10 +1,11 @@
 #include "mainwidget.h"
+#include "camerapath.h"
 #include "config.h"
 
 #include <QMouseEvent>
+#include <QInputDialog>
 
 #include <cmath>
-#include <locale.h>
 
 MainWidget::MainWidget(QWidget *parent) :
 	QGLWidget(parent),
@@ -12,9 +13,36 @@ MainWidget::MainWidget(QWidget *parent) :
 	deltaTime(1),
 	shiftedTime(QDateTime::currentDateTimeUtc()),
 	prevTime(QDateTime::currentDateTimeUtc()),
-	modeFps(false)
+	modeFps(false),
+	showMinimap(false),
+	showCloseups(false)
 {
 	qDebug() << PlanetConfig::cnf[0].name;
+	// Buffers are swapped at the end of paintGL so the swap can be profiled
+	setAutoBufferSwap(false);
+}
+
+void MainWidget::setFrameBudget(double ms)
+{
+	scaler.budgetMs = ms;
+	// Only a request until initializeGL, the blit check needs a context
+	scaler.enabled = true;
+}
+
+void MainWidget::setDynamicResolution(bool enabled)
+{
+	if (enabled && !QOpenGLFramebufferObject::hasOpenGLFramebufferBlit()) {
+		qWarning() << "dynamic resolution: framebuffer blit is not supported, rendering at full resolution";
+		enabled = false;
+	}
+	scaler.enabled = enabled;
+	renderer.profiler.gpuTiming = enabled;
+	qDebug() << "dynamic resolution: " << scaler.enabled << ", budget" << scaler.budgetMs << "ms";
+}
+
+void MainWidget::toggleDynamicResolution()
+{
+	setDynamicResolution(!scaler.enabled);
 }
 
 //! [0]
@@ -48,112 +76,105 @@ void MainWidget::mouseReleaseEvent(QMouseEvent *)
 }
 //! [0]
 
-void MainWidget::viewUp(float alpha)
-{
-	float lim = M_PI / 2.0 - M_PI / 100.0;
-	cameraDirection.setY(std::min(std::max(cameraDirection.y() + alpha, -lim), lim));
-}
-
-void MainWidget::viewRight(float alpha)
+void MainWidget::modifyAngle(float alpha)
 {
-	cameraDirection.setX(cameraDirection.x() + alpha);
-	if (cameraDirection.x() < -M_PI)
-		cameraDirection += QVector2D(2*M_PI, 0);
-	if (cameraDirection.x() > M_PI)
-		cameraDirection -= QVector2D(2*M_PI, 0);
+	camera.viewAngle = std::min(std::max((float)camera.viewAngle - alpha, 10.0f), 120.0f);
 }
 
-QVector3D MainWidget::getDirection()
+void MainWidget::changeDeltaTime(float delta)
 {
-	QVector3D direct(
-		std::cos(cameraDirection.y()) * std::sin(cameraDirection.x()),
-		std::sin(cameraDirection.y()),
-		-std::cos(cameraDirection.y()) * std::cos(cameraDirection.x()));
-	direct.normalize();
-	return direct;
+	float sign = delta < 0 ? -1 : 1;
+	deltaTime = sign * std::max(1.0f, std::min(std::abs(delta), 60 * 60 * 24 * 365 * 10 + .0f));
+	qDebug() << "new deltaTime: " << deltaTime;
 }
 
-void MainWidget::viewForward(float delta)
+void MainWidget::seekTime(QDateTime const &time)
 {
-	QVector3D direct = getDirection();
-	cameraPosition += direct * delta;
+	shiftedTime = time;
+	qDebug() << "seek: " << shiftedTime;
 }
 
-void MainWidget::modifyAngle(float alpha)
+void MainWidget::scrubTime(qint64 msecs)
 {
-	viewAngle = std::min(std::max((float)viewAngle - alpha, 10.0f), 120.0f);
-	stateProjection.setToIdentity();
-	stateProjection.perspective(viewAngle, aspect, zNear, zFar);
-
+	shiftedTime = shiftedTime.addMSecs(msecs);
 }
 
-void MainWidget::changeDeltaTime(float delta)
+void MainWidget::reportTimeline()
 {
-	deltaTime = std::max(1.0f, std::min(delta, 60 * 60 * 24 * 365 * 10 + .0f));
-	qDebug() << "new deltaTime: " << deltaTime;
+	size_t memory = 0;
+	quint64 hits = 0, total = 0;
+	for (unsigned idx = 0; idx < renderer.planets.size(); ++idx) {
+		KeyframeCache const &cache = *renderer.planets[idx]->keyframes;
+		qDebug() << PlanetConfig::cnf[idx].name << "step" << cache.step << "days, hit rate" << cache.hitRate();
+		memory += cache.memoryUsage();
+		hits += cache.hits;
+		total += cache.hits + cache.misses;
+	}
+	qDebug() << "keyframes: " << memory << "bytes, hit rate" << (total ? double(hits) / total : 0);
 }
 
 //! [1]
 void MainWidget::timerEvent(QTimerEvent *)
 {
+	TRACE_ZONE("MainWidget::timerEvent");
+	Profiler &profiler = renderer.profiler;
+	profiler.beginFrame();
+	profiler.begin(Profiler::phaseInput);
+
+	auto &planets = renderer.planets;
 	float alpha = .05;
-	float d = cameraPosition.length();
+	float d = camera.position.length();
 	for (unsigned idx = 0; idx < planets.size(); ++idx)
-		d = std::min(d, cameraPosition.distanceToPoint(planets[idx]->statePosition));
+		d = std::min(d, camera.position.distanceToPoint(planets[idx]->viewPosition(camera.survey)));
 	float delta = std::max(d / 10, .000001f);
-	QVector3D direct = getDirection();
+	QVector3D direct = camera.getDirection();
 	if (holdedKeys.count(Qt::Key_W))
-		viewForward(delta);
+		camera.viewForward(delta);
 
 	if (holdedKeys.count(Qt::Key_S))
-		viewForward(-delta);
+		camera.viewForward(-delta);
 
 	if (holdedKeys.count(Qt::Key_D)) {
 		QVector3D d = QVector3D::normal(direct, direct + QVector3D(0, 1, 0));
-		cameraPosition += d * delta;
+		camera.position += d * delta;
 	}
 
 	if (holdedKeys.count(Qt::Key_A)) {
 		QVector3D d = QVector3D::normal(direct, direct + QVector3D(0, 1, 0));
-		cameraPosition -= d * delta;
+		camera.position -= d * delta;
 	}
 
 	if (holdedKeys.count(Qt::Key_Up))
-		viewUp(alpha);
+		camera.viewUp(alpha);
 
 	if (holdedKeys.count(Qt::Key_Down))
-		viewUp(-alpha);
+		camera.viewUp(-alpha);
 
 	if (holdedKeys.count(Qt::Key_Right))
-		viewRight(alpha);
+		camera.viewRight(alpha);
 
 	if (holdedKeys.count(Qt::Key_Left))
-		viewRight(-alpha);
+		camera.viewRight(-alpha);
 
 	for (char num = '0'; num <= '9'; ++num)
 		if (holdedKeys.count(num)) {
-			QVector3D move = -cameraPosition;
-			float soNear = theSun->radius;
-			if (PlanetConfig::modeSurvey)
-				soNear = aSun->radius;
-			if (num != '0') {
-				move = planets[num - '1']->statePosition - cameraPosition;
-				soNear = planets[num - '1']->radius;
-			}
+			QVector3D move = -camera.position;
+			if (num != '0')
+				move = planets[num - '1']->viewPosition(camera.survey) - camera.position;
 			float x = std::atan2(move.x(), -move.z());
 			float y = std::atan2(move.y(), std::pow(move.x() * move.x() + move.z() * move.z(), .5f));
-			if (x == cameraDirection.x() && y == cameraDirection.y()) {
-				viewForward(delta);
+			if (x == camera.direction.x() && y == camera.direction.y()) {
+				camera.viewForward(delta);
 			} else {
-				viewRight(x - cameraDirection.x());
-				viewUp(y - cameraDirection.y());
+				camera.viewRight(x - camera.direction.x());
+				camera.viewUp(y - camera.direction.y());
 			}
 		}
 
 	if (modeFps) {
 		QPoint pos = QCursor::pos() - mapToGlobal(QPoint(width() / 2, height() / 2));
-		viewUp(-pos.y() * .01);
-		viewRight(pos.x() * .01);
+		camera.viewUp(-pos.y() * .01);
+		camera.viewRight(pos.x() * .01);
 		QCursor::setPos(mapToGlobal(QPoint(width() / 2, height() / 2)));
 	}
 
@@ -162,7 +183,7 @@ void MainWidget::timerEvent(QTimerEvent *)
 	if (holdedKeys.count(Qt::Key_Minus))
 		modifyAngle(-1);
 	if (holdedKeys.count('/'))
-		modifyAngle(viewAngle - 45);
+		modifyAngle(camera.viewAngle - 45);
 
 	if (holdedKeys.count(Qt::Key_C))
 		changeDeltaTime(deltaTime * 2);
@@ -171,6 +192,13 @@ void MainWidget::timerEvent(QTimerEvent *)
 	if (holdedKeys.count(Qt::Key_X))
 		changeDeltaTime(0);
 
+	// Scrub by an hour per tick, or faster if time is already running fast
+	qint64 scrub = std::max(std::abs(deltaTime), 60.0f * 60.0f) * 1000;
+	if (holdedKeys.count(Qt::Key_BracketLeft))
+		scrubTime(-scrub);
+	if (holdedKeys.count(Qt::Key_BracketRight))
+		scrubTime(scrub);
+
 	// // Decrease angular speed (friction)
 	// angularSpeed *= 0.99;
 
@@ -184,95 +212,35 @@ void MainWidget::timerEvent(QTimerEvent *)
 	// 	// Update scene
 	// }
 
+	profiler.end(Profiler::phaseInput);
+	profiler.begin(Profiler::phaseEphemeris);
+
 	QDateTime now = QDateTime::currentDateTimeUtc();
 	if (action)
 		shiftedTime = shiftedTime.addMSecs(deltaTime * prevTime.msecsTo(now));
-	for (unsigned idx = 0; idx < planets.size(); ++idx)
-		planets[idx]->changeTime(shiftedTime);
+	renderer.changeTime(shiftedTime);
+	renderer.update(makeViews(viewportSize));
 	prevTime = now;
+
+	profiler.end(Profiler::phaseEphemeris);
+
 	updateGL();
+	profiler.endFrame();
 }
 //! [1]
 
 void MainWidget::initializeGL()
 {
 	initializeGLFunctions();
-	qglClearColor(Qt::black);
-	initShaders();
-	initObjects();
-
-//! [2]
-	// Enable depth buffer
-	glEnable(GL_DEPTH_TEST);
-
-	// Enable back face culling
-	glEnable(GL_CULL_FACE);
-//! [2]
-
+	if (!renderer.init(const_cast<QGLContext *>(context())))
+		close();
+	if (scaler.enabled)
+		setDynamicResolution(true);
 
 	// Use QBasicTimer because its faster than QTimer
 	timer.start(12, this);
 }
 
-//! [3]
-void MainWidget::initShaders()
-{
-	// Override system locale until shaders are compiled
-	setlocale(LC_NUMERIC, "C");
-
-	// Compile vertex shader
-	if (!programLight.addShaderFromSourceFile(QGLShader::Vertex, ":/vshaderLight.glsl"))
-		close();
-
-	// Compile fragment shader
-	if (!programLight.addShaderFromSourceFile(QGLShader::Fragment, ":/fshaderLight.glsl"))
-		close();
-
-	// Link shader pipeline
-	if (!programLight.link())
-		close();
-
-	// Compile vertex shader
-	if (!programDark.addShaderFromSourceFile(QGLShader::Vertex, ":/vshaderDark.glsl"))
-		close();
-
-	// Compile fragment shader
-	if (!programDark.addShaderFromSourceFile(QGLShader::Fragment, ":/fshaderDark.glsl"))
-		close();
-
-	// Link shader pipeline
-	if (!programDark.link())
-		close();
-
-
-	// if (!programLight.bind())
-	//     close();
-
-	// Restore system locale
-	setlocale(LC_ALL, "");
-}
-//! [3]
-
-//! [4]
-void MainWidget::initObjects()
-{
-	// Load cube.png image
-	glEnable(GL_TEXTURE_2D);
-	// cube_texture = bindTexture(QImage(":/cube.png"));
-
-	for (int idx = 0; idx < PlanetConfig::count; ++idx)
-		planets.push_back(std::unique_ptr<PlanetEngine>(new PlanetEngine(this, PlanetConfig::cnf[idx])));
-
-	theSun.reset(new SphereEngine(696342.0 / 149597870.691));
-	theSun->init(this, QImage(":/sun"));
-
-	aSun.reset(new SphereEngine(0.0002));
-	aSun->init(this, QImage(":/sun"));
-
-	theSky.reset(new SphereEngine(10, /* inverted */ true));
-	theSky->init(this, QImage(":/sky"));
-}
-
 void MainWidget::keyPressEvent(QKeyEvent *key)
 {
 	if (key->key() == Qt::Key_Space) {
@@ -280,9 +248,47 @@ void MainWidget::keyPressEvent(QKeyEvent *key)
 		qDebug() << "Action: " << action;
 	}
 	if (key->key() == Qt::Key_V) {
-		PlanetConfig::modeSurvey = !PlanetConfig::modeSurvey;
+		camera.survey = !camera.survey;
 		deltaTime = 1;
-		qDebug() << "modeSurvey: " << PlanetConfig::modeSurvey;
+		qDebug() << "modeSurvey: " << camera.survey;
+	}
+	if (key->key() == Qt::Key_R)
+		changeDeltaTime(-deltaTime);
+	if (key->key() == Qt::Key_Home)
+		seekTime(QDateTime::currentDateTimeUtc());
+	if (key->key() == Qt::Key_I)
+		reportTimeline();
+	if (key->key() == Qt::Key_F)
+		toggleDynamicResolution();
+	if (key->key() == Qt::Key_M)
+		showMinimap = !showMinimap;
+	if (key->key() == Qt::Key_N)
+		showCloseups = !showCloseups;
+	if (key->key() == Qt::Key_L)
+		renderer.trails.enabled = !renderer.trails.enabled;
+	if (key->key() == Qt::Key_O)
+		renderer.overdraw = !renderer.overdraw;
+	if (key->key() == Qt::Key_P)
+		renderer.profiler.enabled = !renderer.profiler.enabled;
+	if (key->key() == Qt::Key_T) {
+		Trace::enabled = !Trace::enabled;
+		if (!Trace::enabled) {
+			QString fileName = QString("cube-%1.json").arg(QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss"));
+			qDebug() << "trace: " << fileName << Trace::dump(fileName);
+		}
+		qDebug() << "trace: " << Trace::enabled.load();
+	}
+	if (key->key() == Qt::Key_G) {
+		bool ok = false;
+		QString text = QInputDialog::getText(this, "Seek", "UTC date (yyyy-MM-dd hh:mm):",
+			QLineEdit::Normal, shiftedTime.toString("yyyy-MM-dd hh:mm"), &ok);
+		QDateTime time = QDateTime::fromString(text, "yyyy-MM-dd hh:mm");
+		time.setTimeSpec(Qt::UTC);
+		if (ok && time.isValid())
+			seekTime(time);
+		// The release event went to the dialog
+		holdedKeys.clear();
+		return;
 	}
 	holdedKeys.insert(key->key());
 }
@@ -296,46 +302,103 @@ void MainWidget::resizeGL(int w, int h)
 {
 	// Set OpenGL viewport to cover whole widget
 	glViewport(0, 0, w, h);
+	viewportSize = QSize(w, h);
+	sceneTarget.reset();
 
 	// Calculate aspect ratio
-	aspect = qreal(w) / qreal(h ? h : 1);
-
-	// Set near plane to 3.0, far plane to 7.0, field of view 45 degrees
-	zNear = 0.00002, zFar = 15.0, viewAngle = 45.0;
-
-	// Reset projection
-	stateProjection.setToIdentity();
+	camera.aspect = qreal(w) / qreal(h ? h : 1);
 
-	// Set perspective projection
-	stateProjection.perspective(viewAngle, aspect, zNear, zFar);
+	// Reset field of view to 45 degrees
+	camera.viewAngle = 45.0;
 }
 //! [5]
 
-void MainWidget::paintGL()
+std::vector<View> MainWidget::makeViews(QSize const &size)
 {
-	// Clear color and depth buffer
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	// Calculate model view transformation
-	QMatrix4x4 cameraRotation;
-	cameraRotation.rotate(-cameraDirection.y() / M_PI * 180, 1, 0, 0);
-	cameraRotation.rotate(cameraDirection.x() / M_PI * 180, 0, 1, 0);
-
-	QMatrix4x4 currentProjection = stateProjection * cameraRotation;
+	// The main view covers the whole target, so the scissored clear of
+	// each view also clears the window
+	std::vector<View> views(1, View{"main", camera, QRect(QPoint(), size)});
+	int margin = 10;
+
+	if (showMinimap) {
+		// Whole system from above the ecliptic, in the top right corner
+		int side = std::min(size.width(), size.height()) / 3;
+		View minimap{"minimap", Camera(), QRect(size.width() - side - margin, size.height() - side - margin, side, side)};
+		minimap.camera.survey = true;
+		minimap.camera.position = QVector3D(0, .008, .004);
+		minimap.camera.lookAt(QVector3D());
+		views.push_back(minimap);
+	}
 
-	programDark.bind();
-	if (!PlanetConfig::modeSurvey) {
-		theSun->draw(programDark, currentProjection, cameraPosition);
-		theSky->statePosition = cameraPosition;
-		theSky->draw(programDark, currentProjection, cameraPosition);
-	} else 
-		aSun->draw(programDark, currentProjection, cameraPosition);
+	if (showCloseups) {
+		// One inset per planet along the bottom edge
+		auto const &planets = renderer.planets;
+		int side = std::min((size.width() - margin) / int(planets.size()) - margin, size.height() / 5);
+		for (unsigned idx = 0; side > 0 && idx < planets.size(); ++idx) {
+			View closeup{PlanetConfig::cnf[idx].name, Camera(), QRect(margin + idx * (side + margin), margin, side, side)};
+			closeup.camera.position = nearPlanet(*planets[idx]);
+			closeup.camera.lookAt(planets[idx]->worldPosition);
+			views.push_back(closeup);
+		}
+	}
+	return views;
+}
 
-	programLight.bind();
-	programLight.setUniformValue("eyePos", QVector4D(cameraPosition, 0));
-	programLight.setUniformValue("lightPos", QVector4D(-cameraPosition, 1));
+void MainWidget::paintGL()
+{
+	TRACE_ZONE("MainWidget::paintGL");
+	Profiler &profiler = renderer.profiler;
+	profiler.begin(Profiler::phasePaint);
+
+	QStringList stats;
+	if (scaler.enabled && !viewportSize.isEmpty()) {
+		// Render into the corner of a window sized target, then stretch
+		// that corner over the window
+		if (!sceneTarget) {
+			QOpenGLFramebufferObjectFormat format;
+			format.setAttachment(QOpenGLFramebufferObject::Depth);
+			sceneTarget.reset(new QOpenGLFramebufferObject(viewportSize, format));
+		}
+		QSize scaled = scaler.targetSize(viewportSize);
+		sceneTarget->bind();
+		renderer.render(makeViews(scaled));
+		sceneTarget->release();
+
+		glViewport(0, 0, viewportSize.width(), viewportSize.height());
+		QOpenGLFramebufferObject::blitFramebuffer(0, QRect(QPoint(), viewportSize),
+			sceneTarget.get(), QRect(QPoint(), scaled), GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+		scaler.update(profiler.sceneTime());
+		stats << QString("resolution %1% (%2x%3), saving ~%4 ms")
+			.arg(qRound(scaler.scale * 100)).arg(scaled.width()).arg(scaled.height()).arg(scaler.savedMs, 0, 'f', 2);
+	} else
+		renderer.render(makeViews(viewportSize));
+
+	if (renderer.viewStats.size() > 1)
+		for (auto const &view : renderer.viewStats)
+			stats << QString("view %1: cull %2 ms, draw %3 ms, %4 drawn, %5 culled, %6 calls")
+				.arg(view.name).arg(view.buildMs, 0, 'f', 3).arg(view.drawMs, 0, 'f', 3)
+				.arg(view.drawn).arg(view.culled).arg(view.drawCalls);
+
+	if (renderer.trails.enabled)
+		stats << QString("trails: %1 uploads, %2 bytes").arg(renderer.trails.uploads).arg(renderer.trails.uploadedBytes);
+
+	profiler.end(Profiler::phasePaint);
+
+	if (profiler.enabled) {
+		profiler.beginPass(Profiler::passHud);
+		QPainter painter(this);
+		profiler.drawHud(painter, rect(), stats);
+		painter.end();
+		profiler.endPass(Profiler::passHud);
+	}
 
-	// Draw cube geometry
-	for (unsigned idx = 0; idx < planets.size(); ++idx)
-		planets[idx]->draw(programLight, currentProjection, cameraPosition);
+	// Swap here rather than in timerEvent, so frames painted for expose and
+	// resize events reach the screen too
+	profiler.begin(Profiler::phaseSwap);
+	{
+		TRACE_ZONE("swapBuffers");
+		swapBuffers();
+	}
+	profiler.end(Profiler::phaseSwap);
 }
@@ -8,10 +8,13 @@
 #include <QVector2D>
 #include <QBasicTimer>
 #include <QGLShaderProgram>
+#include <QOpenGLFramebufferObject>
 
 #include <unordered_set>
 
-#include "engine.h"
+#include "renderer.h"
+#include "resolution.h"
+#include "trace.h"
 
 class MainWidget : public QGLWidget, protected QGLFunctions
 {
@@ -19,6 +22,7 @@ class MainWidget : public QGLWidget, protected QGLFunctions
 
 public:
 	explicit MainWidget(QWidget *parent = 0);
+	void setFrameBudget(double ms);
 	
 protected:
 	void mousePressEvent(QMouseEvent *e);
@@ -29,42 +33,35 @@ protected:
 	void resizeGL(int w, int h);
 	void paintGL();
 
-	void initShaders();
-	void initObjects();
-	void bindTextureWrap(GLuint textureIdx);
-
 	void keyPressEvent(QKeyEvent *key);
 	void keyReleaseEvent(QKeyEvent *key);
 
-	void viewUp(float alpha);
-	void viewRight(float alpha);
-	void viewForward(float delta);
 	void modifyAngle(float alpha);
 	void changeDeltaTime(float delta);
-	QVector3D getDirection();
+	void seekTime(QDateTime const &time);
+	void scrubTime(qint64 msecs);
+	void reportTimeline();
+	void setDynamicResolution(bool enabled);
+	void toggleDynamicResolution();
+	std::vector<View> makeViews(QSize const &size);
 	
 private:
 	QBasicTimer timer;
 	
-	QGLShaderProgram programLight;
-	QGLShaderProgram programDark;
+	Renderer renderer;
 
-    std::unique_ptr<SphereEngine> theSun;
-    std::unique_ptr<SphereEngine> aSun;
-    std::unique_ptr<SphereEngine> theSky;
-    std::vector<std::unique_ptr<PlanetEngine>> planets;
-    
-	std::unordered_set<int> holdedKeys;
+	ResolutionScaler scaler;
+	std::unique_ptr<QOpenGLFramebufferObject> sceneTarget;
+	QSize viewportSize;
 
-	QMatrix4x4 stateProjection;
-	QQuaternion stateRotation;
+	std::unordered_set<int> holdedKeys;
 
-	QVector3D cameraPosition;
-	QVector2D cameraDirection;
+	Camera camera;
 	bool modeFps;
-	qreal zNear, zFar, viewAngle;
-	qreal aspect;
 	bool action;
+	// Survey minimap and planet close-up insets
+	bool showMinimap;
+	bool showCloseups;
 
 	QDateTime shiftedTime;
 	QDateTime prevTime;
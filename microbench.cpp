@@ -0,0 +1,286 @@
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <limits>
+#include <new>
+
+#include "microbench.h"
+#include "engine.h"
+
+// Counting allocator, one relaxed increment per allocation. This replaces
+// the global operators for the whole bench binary, which is why it is a
+// target of its own
+static std::atomic<quint64> allocations(0);
+
+void *operator new(std::size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void *ptr = std::malloc(size ? size : 1))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+	return ::operator new(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+	std::free(ptr);
+}
+
+#if __cpp_sized_deallocation
+void operator delete(void *ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+#endif
+
+#if __cpp_aligned_new
+// Over-aligned types take these, aligned_alloc wants a multiple of the alignment
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	std::size_t align = static_cast<std::size_t>(alignment);
+	if (void *ptr = std::aligned_alloc(align, (std::max<std::size_t>(size, 1) + align - 1) / align * align))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return ::operator new(size, alignment);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t, std::align_val_t) noexcept
+{
+	std::free(ptr);
+}
+#endif
+
+namespace {
+
+// Heliocentric positions in AU produced by PlanetImpl::getPosition
+struct Reference
+{
+	int year, month, day, hour;
+	PlanetConfig::names body;
+	double x, y, z;
+};
+
+Reference const references[] = {
+	{2000, 1, 1, 12, PlanetConfig::mercury, -0.0866817982, -0.0294217046, 0.457560112},
+	{2000, 1, 1, 12, PlanetConfig::venus, -0.715582272, 0.0403040879, 0.0732234437},
+	{2000, 1, 1, 12, PlanetConfig::earth, -0.211460243, -2.68479353e-07, -0.960285232},
+	{2000, 1, 1, 12, PlanetConfig::mars, 1.39170737, -0.0338504611, -0.0169857497},
+	{2000, 1, 1, 12, PlanetConfig::jupiter, 3.98915787, -0.101565869, -2.95856776},
+	{2000, 1, 1, 12, PlanetConfig::saturn, 6.40621603, -0.368941624, -6.55344994},
+	{2000, 1, 1, 12, PlanetConfig::uranus, 14.430831, -0.238082833, 13.7323142},
+	{2000, 1, 1, 12, PlanetConfig::neptune, 16.8099322, 0.127211207, 24.9891704},
+	{2000, 1, 1, 12, PlanetConfig::pluto, -9.87696144, 5.84972899, 27.9666852},
+	{1950, 1, 1, 0, PlanetConfig::mercury, 0.288376323, -0.0139683552, -0.153600503},
+	{1950, 1, 1, 0, PlanetConfig::venus, 0.053935792, 0.00659552599, -0.717840289},
+	{1950, 1, 1, 0, PlanetConfig::earth, -0.216982295, 0.000108083908, -0.959028006},
+	{1950, 1, 1, 0, PlanetConfig::mars, -1.40959608, 0.0532852093, -0.8832582},
+	{1950, 1, 1, 0, PlanetConfig::jupiter, 3.41954033, -0.0612564393, 3.75118833},
+	{1950, 1, 1, 0, PlanetConfig::saturn, -9.00865461, 0.314118184, -2.4878432},
+	{1950, 1, 1, 0, PlanetConfig::uranus, -1.25042988, 0.0866329676, -18.9037008},
+	{1950, 1, 1, 0, PlanetConfig::neptune, -29.0907182, 0.843472878, 8.41301444},
+	{1950, 1, 1, 0, PlanetConfig::pluto, -26.5358753, 5.07565647, -24.282323},
+	{2013, 11, 25, 0, PlanetConfig::mercury, -0.384682408, 0.0358083284, -0.00628920553},
+	{2013, 11, 25, 0, PlanetConfig::venus, 0.572369157, -0.0269749925, -0.44195597},
+	{2013, 11, 25, 0, PlanetConfig::earth, 0.421613899, -2.82690323e-05, -0.892178793},
+	{2013, 11, 25, 0, PlanetConfig::mars, -1.2693507, 0.0535229968, -1.06726495},
+	{2013, 11, 25, 0, PlanetConfig::jupiter, -1.06560791, 0.00282548928, -5.06727383},
+	{2013, 11, 25, 0, PlanetConfig::saturn, -7.01208537, 0.399476835, 6.9268496},
+	{2013, 11, 25, 0, PlanetConfig::uranus, 19.672637, -0.240872242, -3.79228493},
+	{2013, 11, 25, 0, PlanetConfig::neptune, 27.0183628, -0.355069846, 12.9925823},
+	{2013, 11, 25, 0, PlanetConfig::pluto, 6.14779446, 1.63828844, 31.9275362},
+	{2030, 6, 15, 6, PlanetConfig::mercury, 0.208428035, 0.000106433237, -0.235175859},
+	{2030, 6, 15, 6, PlanetConfig::venus, 0.722678682, -0.0408818708, -0.0592668767},
+	{2030, 6, 15, 6, PlanetConfig::earth, -0.0762321762, 6.99925313e-05, 1.01305489},
+	{2030, 6, 15, 6, PlanetConfig::mars, 0.375505984, 0.0219732508, -1.4876387},
+	{2030, 6, 15, 6, PlanetConfig::jupiter, -3.08754312, 0.0874698464, 4.41667464},
+	{2030, 6, 15, 6, PlanetConfig::saturn, 4.67838005, -0.321675645, -7.79981167},
+	{2030, 6, 15, 6, PlanetConfig::uranus, 3.8816061, 0.0193837531, -18.7925138},
+	{2030, 6, 15, 6, PlanetConfig::neptune, 29.3100146, -0.791212893, -5.6217323},
+	{2030, 6, 15, 6, PlanetConfig::pluto, 23.4791334, -3.82039107, 27.7660853},
+};
+
+// Relative to the distance from the sun, a few float ulps
+double const tolerance = 1e-6;
+
+volatile double sink;
+
+template <typename Op>
+QJsonObject measure(QString const &name, int iterations, Op op)
+{
+	double best = std::numeric_limits<double>::max();
+	quint64 allocs = 0;
+	// Warm up, then keep the fastest of several runs
+	for (int repeat = 0; repeat < 6; ++repeat) {
+		double acc = 0;
+		quint64 before = allocations.load(std::memory_order_relaxed);
+		QElapsedTimer timer;
+		timer.start();
+		for (int idx = 0; idx < iterations; ++idx)
+			acc += op(idx);
+		double ns = timer.nsecsElapsed() / double(iterations);
+		sink = acc;
+		if (repeat) {
+			best = std::min(best, ns);
+			allocs = allocations.load(std::memory_order_relaxed) - before;
+		}
+	}
+
+	QJsonObject result;
+	result["name"] = name;
+	result["iterations"] = iterations;
+	result["ns_per_op"] = best;
+	result["allocs_per_op"] = double(allocs) / iterations;
+	qDebug() << "bench:" << name << best << "ns/op," << double(allocs) / iterations << "allocs/op";
+	return result;
+}
+
+double error(QVector3D const &position, QVector3D const &reference)
+{
+	return position.distanceToPoint(reference) / std::max(1.0f, reference.length());
+}
+
+}
+
+MicroBenchmark::MicroBenchmark(QString const &output_)
+	:output(output_)
+{}
+
+int MicroBenchmark::run()
+{
+	PlanetImpl earth(PlanetConfig::cnf[PlanetConfig::earth]);
+
+	std::vector<QDateTime> times;
+	QDateTime const start(QDate(2000, 1, 1), QTime(12, 0), Qt::UTC);
+	for (int idx = 0; idx < 1024; ++idx)
+		times.push_back(start.addSecs(idx * 3637));
+
+	QJsonArray benchmarks;
+	benchmarks.append(measure("PlanetImpl::getPosition(QDateTime)", 200000, [&](int idx) {
+		return earth.getPosition(times[idx & 1023]).x();
+	}));
+	benchmarks.append(measure("PlanetImpl::getPosition(jdn)", 200000, [&](int idx) {
+		return earth.getPosition(2451545.0 + idx * .042).x();
+	}));
+	benchmarks.append(measure("PlanetImpl::toJulianDay", 200000, [&](int idx) {
+		return earth.toJulianDay(times[idx & 1023]);
+	}));
+	benchmarks.append(measure("PlanetImpl::getRotationAngle", 200000, [&](int idx) {
+		return earth.getRotationAngle(times[idx & 1023]);
+	}));
+
+	// Kepler's equation converges slower as eccentricity grows
+	double const eccentricities[] = {0, .05, .2, .5, .9};
+	for (double e : eccentricities) {
+		PlanetImpl::Orbit orbit = {1, e, .1, 1, .5, 0};
+		benchmarks.append(measure(QString("PlanetImpl::getEllipsePos e=%1").arg(e), 200000, [&](int idx) {
+			return earth.getEllipsePos(orbit, (idx % 628) / 100.0 - 3.14).x();
+		}));
+	}
+
+	KeyframeCache keyframes(earth);
+	benchmarks.append(measure("KeyframeCache::getPosition", 200000, [&](int idx) {
+		return keyframes.getPosition(2451545.0 + idx * .042).x();
+	}));
+
+	int const counts[] = {12, 30, 64};
+	for (int cnt : counts) {
+		SphereEngine sphere(1, false, cnt);
+		benchmarks.append(measure(QString("SphereEngine::initGeometry cnt=%1").arg(cnt), 200, [&](int) {
+			sphere.initGeometry();
+			return double(sphere.indices.size());
+		}));
+	}
+
+	bool passed = true;
+	QJsonArray accuracy;
+	for (auto const &reference : references) {
+		PlanetImpl impl(PlanetConfig::cnf[reference.body]);
+		QDateTime epoch(QDate(reference.year, reference.month, reference.day), QTime(reference.hour, 0), Qt::UTC);
+		double err = error(impl.getPosition(epoch), QVector3D(reference.x, reference.y, reference.z));
+		bool ok = err <= tolerance;
+		passed = passed && ok;
+
+		QJsonObject result;
+		result["body"] = PlanetConfig::cnf[reference.body].name;
+		result["epoch"] = epoch.toString(Qt::ISODate);
+		result["error"] = err;
+		result["ok"] = ok;
+		accuracy.append(result);
+		if (!ok)
+			qWarning() << "accuracy:" << PlanetConfig::cnf[reference.body].name << epoch << "error" << err;
+	}
+
+	// Interpolated keyframes against direct evaluation, over ten years
+	for (int body = 0; body < PlanetConfig::count; ++body) {
+		PlanetImpl impl(PlanetConfig::cnf[body]);
+		KeyframeCache cache(impl);
+		double worst = 0;
+		for (int idx = 0; idx < 1000; ++idx) {
+			double jdn = 2451545.0 + idx * 3.6525 + .37;
+			worst = std::max(worst, error(cache.getPosition(jdn), impl.getPosition(jdn)));
+		}
+		bool ok = worst <= tolerance;
+		passed = passed && ok;
+
+		QJsonObject result;
+		result["body"] = PlanetConfig::cnf[body].name;
+		result["epoch"] = "keyframes";
+		result["error"] = worst;
+		result["ok"] = ok;
+		accuracy.append(result);
+		if (!ok)
+			qWarning() << "accuracy:" << PlanetConfig::cnf[body].name << "keyframes error" << worst;
+	}
+
+	QJsonObject report;
+	report["benchmarks"] = benchmarks;
+	report["accuracy"] = accuracy;
+	report["tolerance"] = tolerance;
+	report["passed"] = passed;
+
+	QFile file(output);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return 1;
+	file.write(QJsonDocument(report).toJson());
+	return passed ? 0 : 2;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <QString>
+
+// Timings (ns/op, allocations/op) of the ephemeris and mesh hot paths plus
+// accuracy checks against positions pinned at reference epochs. Results are
+// written as JSON so runs can be compared across commits.
+struct MicroBenchmark
+{
+	explicit MicroBenchmark(QString const &output_);
+	// Returns non-zero if any accuracy check failed
+	int run();
+
+	QString const output;
+};
@@ -0,0 +1,75 @@
+#include <QDebug>
+
+#include <cstring>
+
+#include "offscreen.h"
+#include "trace.h"
+
+OffscreenTarget::OffscreenTarget(QSize const &size_)
+	:size(size_)
+{}
+
+bool OffscreenTarget::init()
+{
+	QSurfaceFormat format;
+	format.setDepthBufferSize(24);
+
+	surface.setFormat(format);
+	surface.create();
+
+	context.setFormat(format);
+	if (!context.create() || !context.makeCurrent(&surface)) {
+		qWarning() << "offscreen: could not create an OpenGL context";
+		return false;
+	}
+	if (size.isEmpty())
+		return true;
+
+	QOpenGLFramebufferObjectFormat fboFormat;
+	fboFormat.setAttachment(QOpenGLFramebufferObject::Depth);
+	fbo.reset(new QOpenGLFramebufferObject(size, fboFormat));
+	return fbo->bind();
+}
+
+QGLContext *OffscreenTarget::glContext()
+{
+	return QGLContext::fromOpenGLContext(&context);
+}
+
+ReadbackRing::ReadbackRing()
+	:sizes(depth)
+{
+	// Copies of a QOpenGLBuffer share one buffer object, construct each
+	for (int idx = 0; idx < depth; ++idx)
+		buffers.push_back(QOpenGLBuffer(QOpenGLBuffer::PixelPackBuffer));
+}
+
+void ReadbackRing::read(int index, QSize const &size)
+{
+	QOpenGLBuffer &buffer = buffers[index % depth];
+	int bytes = size.width() * size.height() * 4;
+	if (!buffer.isCreated()) {
+		buffer.create();
+		buffer.setUsagePattern(QOpenGLBuffer::StreamRead);
+	}
+	buffer.bind();
+	if (buffer.size() < bytes)
+		buffer.allocate(bytes);
+	glReadPixels(0, 0, size.width(), size.height(), GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	buffer.release();
+	sizes[index % depth] = size;
+}
+
+QImage ReadbackRing::take(int index)
+{
+	TRACE_ZONE("ReadbackRing::take");
+	QOpenGLBuffer &buffer = buffers[index % depth];
+	QImage image(sizes[index % depth], QImage::Format_RGBA8888);
+	buffer.bind();
+	if (void *data = buffer.map(QOpenGLBuffer::ReadOnly)) {
+		std::memcpy(image.bits(), data, image.width() * image.height() * 4);
+		buffer.unmap();
+	}
+	buffer.release();
+	return image;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <QImage>
+#include <QOffscreenSurface>
+#include <QOpenGLBuffer>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QGLContext>
+
+#include <memory>
+#include <vector>
+
+// A context on a hidden surface with a framebuffer object of the given size
+// bound, for rendering without a window. An empty size only makes the
+// context current, for callers that bring their own framebuffers
+struct OffscreenTarget
+{
+	explicit OffscreenTarget(QSize const &size_ = QSize());
+	bool init();
+	QGLContext *glContext();
+
+	QSize const size;
+	QOffscreenSurface surface;
+	QOpenGLContext context;
+	std::unique_ptr<QOpenGLFramebufferObject> fbo;
+};
+
+// glReadPixels into a ring of pixel buffers, so reading back never waits
+// for the GPU: read number n is only mapped by take(n) after the reads
+// up to n + depth - 1 have been issued, when its transfer has long
+// finished. Images come out bottom up, as GL stores them
+struct ReadbackRing
+{
+	enum {
+		depth = 3
+	};
+
+	ReadbackRing();
+	// Starts copying the bound framebuffer, buffers grow to the largest size
+	void read(int index, QSize const &size);
+	QImage take(int index);
+
+private:
+	std::vector<QOpenGLBuffer> buffers;
+	std::vector<QSize> sizes;
+};
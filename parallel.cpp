@@ -0,0 +1,95 @@
+#include <QtGlobal>
+
+#include <algorithm>
+
+#include "parallel.h"
+
+ThreadPool::ThreadPool(int threads)
+	:job(0),
+	jobCount(0),
+	jobChunk(1),
+	next(0),
+	busy(0),
+	generation(0),
+	done(false)
+{
+	for (int idx = 0; idx < threads; ++idx)
+		workers.push_back(std::thread(&ThreadPool::work, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		done = true;
+	}
+	changed.notify_all();
+	for (auto &worker : workers)
+		worker.join();
+}
+
+int ThreadPool::size() const
+{
+	return workers.size() + 1;
+}
+
+void ThreadPool::drain()
+{
+	for (;;) {
+		int begin = next.fetch_add(jobChunk);
+		if (begin >= jobCount)
+			return;
+		int end = std::min(jobCount, begin + jobChunk);
+		for (int idx = begin; idx < end; ++idx)
+			(*job)(idx);
+	}
+}
+
+void ThreadPool::run(int count, std::function<void(int)> const &fn, int chunk)
+{
+	// Not worth waking anyone up
+	if (workers.empty() || count <= chunk) {
+		for (int idx = 0; idx < count; ++idx)
+			fn(idx);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = &fn;
+		jobCount = count;
+		jobChunk = std::max(1, chunk);
+		next = 0;
+		busy = workers.size();
+		++generation;
+	}
+	changed.notify_all();
+
+	drain();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	changed.wait(lock, [this] { return busy == 0; });
+	job = 0;
+}
+
+void ThreadPool::work()
+{
+	quint64 seen = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [&] { return done || generation != seen; });
+			if (done)
+				return;
+			seen = generation;
+		}
+
+		drain();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			--busy;
+		}
+		changed.notify_all();
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent fork-join pool: run() calls fn(idx) for every idx in
+// [0, count) on the workers and the calling thread and returns when all
+// calls have finished
+struct ThreadPool
+{
+	explicit ThreadPool(int threads);
+	~ThreadPool();
+
+	void run(int count, std::function<void(int)> const &fn, int chunk = 1);
+
+	int size() const;
+
+private:
+	void work();
+	void drain();
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable changed;
+
+	std::function<void(int)> const *job;
+	int jobCount;
+	int jobChunk;
+	std::atomic<int> next;
+	int busy;
+	quint64 generation;
+	bool done;
+};
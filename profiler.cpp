@@ -0,0 +1,172 @@
+#include <algorithm>
+
+#include "profiler.h"
+
+Profiler::Counters Profiler::counters = {0, 0, 0, 0, 0};
+
+static char const *phaseNames[Profiler::phaseCount] = {"input", "ephemeris", "paintGL", "swap"};
+static char const *passNames[Profiler::passCount] = {"opaque", "trails", "sky", "insets", "hud"};
+
+// Exponential smoothing so the numbers are readable
+static void smooth(double &value, double sample)
+{
+	value = value * .9 + sample * .1;
+}
+
+Profiler::Profiler()
+	:enabled(false),
+	gpuTiming(false),
+	history(historySize, 0),
+	historyPos(0),
+	gpuTimers(false),
+	frame(0)
+{
+	std::fill(phaseTimes, phaseTimes + phaseCount, 0);
+	std::fill(passTimes, passTimes + passCount, 0);
+	lastCounters = counters;
+	frameTimer.start();
+}
+
+void Profiler::initGL()
+{
+#ifndef QT_OPENGL_ES_2
+	gpuTimers = true;
+	for (int idx = 0; idx < queryLatency * passCount; ++idx) {
+		queries.push_back(std::unique_ptr<QOpenGLTimerQuery>(new QOpenGLTimerQuery));
+		gpuTimers = gpuTimers && queries.back()->create();
+	}
+	issued.assign(queries.size(), false);
+#endif
+	if (!gpuTimers)
+		qDebug() << "profiler: GPU timer queries are not supported";
+}
+
+void Profiler::collectQueries(int slot)
+{
+#ifndef QT_OPENGL_ES_2
+	// Results are read queryLatency frames late, so this never stalls
+	for (int pass = 0; pass < passCount; ++pass) {
+		int idx = slot * passCount + pass;
+		if (issued[idx] && queries[idx]->isResultAvailable())
+			smooth(passTimes[pass], queries[idx]->waitForResult() / 1e6);
+		issued[idx] = false;
+	}
+#else
+	Q_UNUSED(slot);
+#endif
+}
+
+void Profiler::beginFrame()
+{
+	double elapsed = frameTimer.nsecsElapsed() / 1e6;
+	frameTimer.restart();
+	history[historyPos] = elapsed;
+	historyPos = (historyPos + 1) % historySize;
+
+	++frame;
+	if (gpuTimers)
+		collectQueries(frame % queryLatency);
+	resetCounters();
+}
+
+void Profiler::resetCounters()
+{
+	counters = Counters{0, 0, 0, 0, 0};
+}
+
+void Profiler::endFrame()
+{
+	lastCounters = counters;
+}
+
+void Profiler::begin(phases phase)
+{
+	phaseTimers[phase].start();
+}
+
+void Profiler::end(phases phase)
+{
+	smooth(phaseTimes[phase], phaseTimers[phase].nsecsElapsed() / 1e6);
+}
+
+void Profiler::beginPass(passes pass)
+{
+#ifndef QT_OPENGL_ES_2
+	if ((enabled || gpuTiming) && gpuTimers) {
+		int idx = (frame % queryLatency) * passCount + pass;
+		queries[idx]->begin();
+		issued[idx] = true;
+	}
+#else
+	Q_UNUSED(pass);
+#endif
+}
+
+void Profiler::endPass(passes pass)
+{
+#ifndef QT_OPENGL_ES_2
+	if ((enabled || gpuTiming) && gpuTimers)
+		queries[(frame % queryLatency) * passCount + pass]->end();
+#else
+	Q_UNUSED(pass);
+#endif
+}
+
+double Profiler::percentile(double p) const
+{
+	std::vector<double> sorted(history);
+	auto nth = sorted.begin() + static_cast<int>(p * (sorted.size() - 1));
+	std::nth_element(sorted.begin(), nth, sorted.end());
+	return *nth;
+}
+
+double Profiler::sceneTime() const
+{
+	if (gpuTimers)
+		return passTimes[passOpaque] + passTimes[passTrails] + passTimes[passSky] + passTimes[passInsets];
+	return phaseTimes[phasePaint] + phaseTimes[phaseSwap];
+}
+
+void Profiler::drawHud(QPainter &painter, QRect const &rect, QStringList const &extra)
+{
+	int const lineHeight = 16;
+	int const graphHeight = 60;
+	double const graphScale = 33.3;
+
+	QRect panel(rect.left() + 10, rect.top() + 10, historySize + 20, lineHeight * (phaseCount + passCount + 4 + extra.size()) + graphHeight + 20);
+	painter.fillRect(panel, QColor(0, 0, 0, 160));
+	painter.setPen(Qt::white);
+
+	int x = panel.left() + 10;
+	int y = panel.top() + lineHeight;
+	auto line = [&](QString const &text) {
+		painter.drawText(x, y, text);
+		y += lineHeight;
+	};
+
+	line(QString("frame p50 %1 ms  p99 %2 ms").arg(percentile(.5), 0, 'f', 2).arg(percentile(.99), 0, 'f', 2));
+	for (int phase = 0; phase < phaseCount; ++phase)
+		line(QString("cpu %1: %2 ms").arg(phaseNames[phase]).arg(phaseTimes[phase], 0, 'f', 3));
+	for (int pass = 0; pass < passCount; ++pass)
+		if (gpuTimers)
+			line(QString("gpu %1: %2 ms").arg(passNames[pass]).arg(passTimes[pass], 0, 'f', 3));
+		else
+			line(QString("gpu %1: n/a").arg(passNames[pass]));
+	line(QString("draws %1  triangles %2  texture binds %3")
+		.arg(lastCounters.drawCalls).arg(lastCounters.triangles).arg(lastCounters.textureBinds));
+	line(QString("state changes %1  allocations %2").arg(lastCounters.stateChanges).arg(lastCounters.allocations));
+	for (auto const &text : extra)
+		line(text);
+
+	// Frame time histogram, oldest on the left, one bar per frame
+	int bottom = y + graphHeight;
+	painter.setPen(QColor(255, 255, 255, 80));
+	int budget = bottom - static_cast<int>(16.7 / graphScale * graphHeight);
+	painter.drawLine(x, budget, x + historySize, budget);
+	painter.setPen(QColor(120, 220, 120));
+	for (int idx = 0; idx < historySize; ++idx) {
+		double value = history[(historyPos + idx) % historySize];
+		int height = std::min(graphHeight, static_cast<int>(value / graphScale * graphHeight));
+		painter.drawLine(x + idx, bottom, x + idx, bottom - height);
+	}
+}
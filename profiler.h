@@ -0,0 +1,95 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QPainter>
+#include <QStringList>
+
+#ifndef QT_OPENGL_ES_2
+#include <QOpenGLTimerQuery>
+#endif
+
+#include <memory>
+#include <vector>
+
+// Per frame CPU phase timings, GPU pass timings (GL_TIME_ELAPSED) and draw
+// counters, shown as an overlay on top of the scene
+struct Profiler
+{
+	enum phases {
+		phaseInput,
+		phaseEphemeris,
+		phasePaint,
+		phaseSwap,
+		phaseCount
+	};
+
+	enum passes {
+		passOpaque,
+		passTrails,
+		passSky,
+		passInsets,
+		passHud,
+		passCount
+	};
+
+	struct Counters
+	{
+		int drawCalls;
+		int triangles;
+		int textureBinds;
+		// Program, mesh and texture binds of sorted submission
+		int stateChanges;
+		// Heap allocations of the per frame arenas
+		int allocations;
+	};
+
+	Profiler();
+	void initGL();
+
+	void beginFrame();
+	void endFrame();
+	void begin(phases phase);
+	void end(phases phase);
+	void beginPass(passes pass);
+	void endPass(passes pass);
+
+	void drawHud(QPainter &painter, QRect const &rect, QStringList const &extra = QStringList());
+
+	// GPU time of the scene passes, or CPU paint and swap time where timer
+	// queries are not available
+	double sceneTime() const;
+
+	// Counts of the current frame. Renderer::render starts them from zero,
+	// as the offscreen modes never call beginFrame
+	static Counters counters;
+	static void resetCounters();
+
+	bool enabled;
+	// Keep timing passes with the overlay hidden
+	bool gpuTiming;
+
+private:
+	enum {
+		historySize = 240,
+		queryLatency = 3
+	};
+
+	void collectQueries(int slot);
+	double percentile(double p) const;
+
+	QElapsedTimer frameTimer;
+	QElapsedTimer phaseTimers[phaseCount];
+	double phaseTimes[phaseCount];
+	double passTimes[passCount];
+	Counters lastCounters;
+
+	std::vector<double> history;
+	int historyPos;
+
+#ifndef QT_OPENGL_ES_2
+	std::vector<std::unique_ptr<QOpenGLTimerQuery>> queries;
+	std::vector<bool> issued;
+#endif
+	bool gpuTimers;
+	int frame;
+};
@@ -0,0 +1,392 @@
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <limits>
+#include <locale.h>
+
+#include "renderer.h"
+#include "trace.h"
+
+Renderer::Renderer()
+	:overdraw(false),
+	julianDay(0),
+	shaderMs(0),
+	pool(std::max(0, std::min(3, static_cast<int>(std::thread::hardware_concurrency()) - 1)))
+{}
+
+bool Renderer::init(QGLContext *context)
+{
+	initializeGLFunctions(context);
+	glClearColor(0, 0, 0, 1);
+	if (!initShaders())
+		return false;
+	locations[shaderDark].resolve(programDark);
+	locations[shaderLight].resolve(programLight);
+	locations[shaderSky].resolve(programSky);
+	overdrawLocations[shaderDark].resolve(programOverdraw);
+	overdrawLocations[shaderLight].resolve(programOverdraw);
+	overdrawLocations[shaderSky].resolve(programSkyOverdraw);
+	lineLocations.resolve(programLine);
+	lineOverdrawLocations.resolve(programLineOverdraw);
+	initObjects(context);
+	profiler.initGL();
+	return true;
+}
+
+bool Renderer::initShaders()
+{
+	TRACE_ZONE("Renderer::initShaders");
+	QElapsedTimer timer;
+	timer.start();
+
+	// Override system locale until shaders are compiled
+	setlocale(LC_NUMERIC, "C");
+
+	bool ok =
+		shaderCache.load(programLight, ":/vshaderLight.glsl", ":/fshaderLight.glsl")
+		&& shaderCache.load(programDark, ":/vshaderDark.glsl", ":/fshaderDark.glsl")
+		&& shaderCache.load(programSky, ":/vshaderSky.glsl", ":/fshaderDark.glsl")
+		&& shaderCache.load(programOverdraw, ":/vshaderDark.glsl", ":/fshaderOverdraw.glsl")
+		&& shaderCache.load(programSkyOverdraw, ":/vshaderSky.glsl", ":/fshaderOverdraw.glsl")
+		&& shaderCache.load(programLine, ":/vshaderLine.glsl", ":/fshaderLine.glsl")
+		&& shaderCache.load(programLineOverdraw, ":/vshaderLine.glsl", ":/fshaderOverdraw.glsl");
+
+	// Restore system locale
+	setlocale(LC_ALL, "");
+
+	shaderMs = timer.nsecsElapsed() / 1e6;
+	qDebug() << "shaders:" << shaderMs << "ms," << shaderCache.hits << "cached," << shaderCache.misses << "compiled";
+	return ok;
+}
+
+static QImage loadTexture(QString const &name)
+{
+	TRACE_ZONE("loadTexture");
+	return QImage(":/" + name);
+}
+
+void Renderer::initObjects(QGLContext *context)
+{
+	TRACE_ZONE("Renderer::initObjects");
+
+	glEnable(GL_TEXTURE_2D);
+
+	for (int idx = 0; idx < PlanetConfig::count; ++idx)
+		planets.push_back(std::unique_ptr<PlanetEngine>(new PlanetEngine(context, PlanetConfig::cnf[idx], loadTexture(PlanetConfig::cnf[idx].name))));
+
+	// One shared image, so bindTexture hands every moon the same texture
+	QImage moonTexture = loadTexture("moon");
+	for (int idx = 0; idx < PlanetConfig::moonCount; ++idx) {
+		PlanetConfig::Moon const &moon = PlanetConfig::moons[idx];
+		moons.push_back(std::unique_ptr<PlanetEngine>(new PlanetEngine(context, moon.cnf, moonTexture, 12)));
+		planets[moon.parent]->attach(moons.back().get());
+	}
+	for (unsigned idx = 0; idx < planets.size(); ++idx)
+		planets[idx]->updateTransform();
+
+	theSun.reset(new SphereEngine(696342.0 / 149597870.691));
+	theSun->init(context, loadTexture("sun"));
+	theSun->updateTransform();
+
+	aSun.reset(new SphereEngine(0.0002));
+	aSun->init(context, loadTexture("sun"));
+	aSun->updateTransform();
+
+	theSky.reset(new SphereEngine(10, /* inverted */ true));
+	theSky->init(context, loadTexture("sky"));
+
+	trails.init(context, planets.size() + moons.size());
+}
+
+void Renderer::changeTime(QDateTime const &time)
+{
+	julianDay = planets[0]->impl->toJulianDay(time);
+	for (unsigned idx = 0; idx < planets.size(); ++idx)
+		planets[idx]->changeTime(time);
+	for (unsigned idx = 0; idx < moons.size(); ++idx)
+		moons[idx]->changeTime(time);
+	for (unsigned idx = 0; idx < planets.size(); ++idx)
+		planets[idx]->updateTransform();
+}
+
+void Renderer::clearKeyframes()
+{
+	for (auto &planet : planets)
+		planet->keyframes->clear();
+	for (auto &moon : moons)
+		moon->keyframes->clear();
+}
+
+void Renderer::render(Camera const &camera)
+{
+	render(std::vector<View>(1, View{"main", camera, QRect()}));
+}
+
+void Renderer::render(std::vector<View> const &views)
+{
+	TRACE_ZONE("Renderer::render");
+	Profiler::resetCounters();
+
+	// Culling and sorting only read the bodies, so views are independent
+	drawLists.resize(views.size());
+	if (views.size() == 1)
+		buildDrawList(views[0].camera, drawLists[0]);
+	else
+		pool.run(views.size(), [&](int idx) {
+			buildDrawList(views[idx].camera, drawLists[idx]);
+		});
+
+	for (auto const &list : drawLists)
+		Profiler::counters.allocations += list.arena.allocations;
+
+	// Only the vertices Renderer::update changed
+	if (trails.enabled)
+		trails.upload();
+
+	// Enable depth buffer, QPainter turns it off when drawing the profiler
+	glEnable(GL_DEPTH_TEST);
+
+	// Enable back face culling
+	glEnable(GL_CULL_FACE);
+
+	if (overdraw) {
+		// Count shaded fragments: depth test still rejects hidden ones
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+	}
+
+	if (viewStats.size() != views.size())
+		viewStats.assign(views.size(), ViewStats{QString(), 0, 0, 0, 0, 0});
+
+	// Insets share one GPU pass, so the main view keeps its pass timings
+	for (unsigned idx = 0; idx < views.size(); ++idx) {
+		if (idx == 1)
+			profiler.beginPass(Profiler::passInsets);
+
+		QElapsedTimer timer;
+		timer.start();
+		int drawCalls = Profiler::counters.drawCalls;
+		drawView(views[idx], drawLists[idx], idx == 0);
+
+		ViewStats &stats = viewStats[idx];
+		stats.name = views[idx].name;
+		stats.buildMs = stats.buildMs * .9 + drawLists[idx].buildMs * .1;
+		stats.drawMs = stats.drawMs * .9 + timer.nsecsElapsed() / 1e6 * .1;
+		stats.drawn = drawLists[idx].queue.count;
+		stats.culled = drawLists[idx].culled;
+		stats.drawCalls = Profiler::counters.drawCalls - drawCalls;
+	}
+	if (views.size() > 1)
+		profiler.endPass(Profiler::passInsets);
+
+	if (overdraw)
+		glDisable(GL_BLEND);
+
+	if (!views[0].viewport.isEmpty()) {
+		QRect const &viewport = views[0].viewport;
+		glViewport(viewport.x(), viewport.y(), viewport.width(), viewport.height());
+	}
+}
+
+void Renderer::buildDrawList(Camera const &camera, DrawList &list)
+{
+	TRACE_ZONE("Renderer::buildDrawList");
+	QElapsedTimer timer;
+	timer.start();
+
+	// Frustum planes of the camera relative clip matrix, xyz pointing inside
+	QMatrix4x4 clip = camera.projection() * camera.rotation();
+	QVector4D planes[6];
+	for (int axis = 0; axis < 3; ++axis) {
+		planes[2 * axis] = clip.row(3) + clip.row(axis);
+		planes[2 * axis + 1] = clip.row(3) - clip.row(axis);
+	}
+	for (auto &plane : planes)
+		plane /= plane.toVector3D().length();
+
+	list.arena.reset();
+	list.queue.begin(list.arena, planets.size() + moons.size() + 2);
+	list.culled = 0;
+	auto add = [&](SphereEngine *body, int shader, QVector3D const &position) {
+		QVector3D center = position - camera.position;
+		for (auto const &plane : planes)
+			if (QVector3D::dotProduct(plane.toVector3D(), center) + plane.w() < -body->radius) {
+				++list.culled;
+				return;
+			}
+		list.queue.push(DrawQueue::makeKey(drawOpaque, shader, body->textureIdx, body->vboIds[0], center.lengthSquared()), body, position);
+	};
+
+	SphereEngine *sun = camera.survey ? aSun.get() : theSun.get();
+	add(sun, shaderDark, sun->worldPosition);
+	for (auto &planet : planets)
+		add(planet.get(), shaderLight, planet->viewPosition(camera.survey));
+
+	// Moon orbits are not scaled in survey mode, they would end up inside planets
+	if (!camera.survey)
+		for (auto &moon : moons)
+			add(moon.get(), shaderLight, moon->worldPosition);
+
+	// The sky follows the camera and sits at the far plane, so it goes last
+	// and only fills the pixels left uncovered
+	if (!camera.survey)
+		list.queue.push(DrawQueue::makeKey(drawSky, shaderSky, theSky->textureIdx, theSky->vboIds[0], 0), theSky.get(), camera.position);
+
+	// Grouped by program, then front to back so the depth test rejects
+	// hidden fragments early; texture and mesh only order equal depths
+	list.queue.sort(list.arena);
+	list.buildMs = timer.nsecsElapsed() / 1e6;
+}
+
+void Renderer::selectShader(int shader, QGLShaderProgram *&program, ProgramLocations const *&locations_)
+{
+	QGLShaderProgram *const programs[shaderCount] = {&programDark, &programLight, &programSky};
+	QGLShaderProgram *const overdrawPrograms[shaderCount] = {&programOverdraw, &programOverdraw, &programSkyOverdraw};
+	program = overdraw ? overdrawPrograms[shader] : programs[shader];
+	locations_ = overdraw ? &overdrawLocations[shader] : &locations[shader];
+}
+
+int Renderer::submit(DrawQueue const &queue, int first, int pass, Camera const &camera, QMatrix4x4 const &projection)
+{
+	TRACE_ZONE("Renderer::submit");
+
+	// Only bind what differs from the previous packet
+	int shader = -1;
+	QGLShaderProgram *program = 0;
+	ProgramLocations const *bound = 0;
+	BaseEngine *mesh = 0;
+	GLuint texture = 0;
+
+	int idx = first;
+	for (; idx < queue.count && DrawQueue::keyPass(queue.packets[idx].key) == pass; ++idx) {
+		DrawPacket const &packet = queue.packets[idx];
+		BaseEngine *body = packet.body;
+
+		if (DrawQueue::keyProgram(packet.key) != shader) {
+			if (mesh)
+				mesh->unbindMesh(*bound);
+			shader = DrawQueue::keyProgram(packet.key);
+			selectShader(shader, program, bound);
+			program->bind();
+			program->setUniformValue(bound->texture, 0);
+			if (bound->eyePos >= 0) {
+				program->setUniformValue(bound->eyePos, QVector4D(camera.position, 0));
+				program->setUniformValue(bound->lightPos, QVector4D(-camera.position, 1));
+			}
+			// Attribute locations may differ between programs
+			mesh = 0;
+			++Profiler::counters.stateChanges;
+		}
+		if (!mesh || mesh->vboIds[0] != body->vboIds[0]) {
+			body->bindMesh(*bound);
+			mesh = body;
+			++Profiler::counters.stateChanges;
+		}
+		if (body->textureIdx != texture) {
+			body->bindTexture();
+			texture = body->textureIdx;
+			++Profiler::counters.stateChanges;
+		}
+		body->drawMesh(*program, *bound, projection, camera.position, packet.position);
+	}
+	if (mesh)
+		mesh->unbindMesh(*bound);
+	return idx;
+}
+
+void Renderer::drawView(View const &view, DrawList const &list, bool timePasses)
+{
+	TRACE_ZONE("Renderer::drawView");
+	Camera const &camera = view.camera;
+
+	if (!view.viewport.isEmpty()) {
+		QRect const &viewport = view.viewport;
+		glViewport(viewport.x(), viewport.y(), viewport.width(), viewport.height());
+		glScissor(viewport.x(), viewport.y(), viewport.width(), viewport.height());
+		glEnable(GL_SCISSOR_TEST);
+	}
+
+	// Clear color and depth buffer
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	QMatrix4x4 currentProjection = camera.projection() * camera.rotation();
+
+	if (timePasses)
+		profiler.beginPass(Profiler::passOpaque);
+	int next = submit(list.queue, 0, drawOpaque, camera, currentProjection);
+	if (timePasses) {
+		profiler.endPass(Profiler::passOpaque);
+		profiler.beginPass(Profiler::passTrails);
+	}
+	if (trails.enabled)
+		drawTrails(camera, currentProjection);
+	if (timePasses) {
+		profiler.endPass(Profiler::passTrails);
+		profiler.beginPass(Profiler::passSky);
+	}
+
+	glDepthFunc(GL_LEQUAL);
+	submit(list.queue, next, drawSky, camera, currentProjection);
+	glDepthFunc(GL_LESS);
+	if (timePasses)
+		profiler.endPass(Profiler::passSky);
+
+	if (!view.viewport.isEmpty())
+		glDisable(GL_SCISSOR_TEST);
+}
+
+void Renderer::update(Camera const &camera)
+{
+	update(std::vector<View>(1, View{"main", camera, QRect()}));
+}
+
+void Renderer::update(std::vector<View> const &views)
+{
+	if (!trails.enabled)
+		return;
+	TRACE_ZONE("Renderer::update");
+
+	// Trails advance once per simulated time, so the view closest to a body
+	// decides its screen space error for all views. Survey views see the
+	// body and its trail shrunk by the same scale, their distance is
+	// compared in true scale units
+	bool trueScale = false;
+	for (unsigned idx = 0; idx < planets.size(); ++idx) {
+		PlanetEngine const &planet = *planets[idx];
+		float distance = std::numeric_limits<float>::max();
+		for (auto const &view : views) {
+			float scale = view.camera.survey ? planet.surveyScale : 1;
+			distance = std::min(distance, (planet.viewPosition(view.camera.survey) - view.camera.position).length() / scale);
+			trueScale = trueScale || !view.camera.survey;
+		}
+		trails.update(idx, -1, *planet.impl, julianDay, planet.worldPosition, distance);
+	}
+
+	// Moons are not drawn in survey views
+	if (!trueScale)
+		return;
+	for (unsigned idx = 0; idx < moons.size(); ++idx) {
+		float distance = std::numeric_limits<float>::max();
+		for (auto const &view : views)
+			if (!view.camera.survey)
+				distance = std::min(distance, moons[idx]->worldPosition.distanceToPoint(view.camera.position));
+		trails.update(planets.size() + idx, PlanetConfig::moons[idx].parent, *moons[idx]->impl, julianDay,
+			moons[idx]->worldPosition, distance);
+	}
+}
+
+void Renderer::drawTrails(Camera const &camera, QMatrix4x4 const &projection)
+{
+	TRACE_ZONE("Renderer::drawTrails");
+	static_assert(PlanetConfig::count + 1 <= Trails::maxOrigins, "origins of moon orbits do not fit vshaderLine.glsl");
+
+	// Moon orbits are relative to their planet, which moves every frame
+	QVector3D origins[PlanetConfig::count + 1];
+	for (unsigned idx = 0; idx < planets.size(); ++idx)
+		origins[idx + 1] = planets[idx]->worldPosition;
+
+	QGLShaderProgram &program = overdraw ? programLineOverdraw : programLine;
+	program.bind();
+	trails.draw(program, overdraw ? lineOverdrawLocations : lineLocations, projection, camera.position, camera.survey,
+		camera.survey ? planets.size() : planets.size() + moons.size(), origins, PlanetConfig::count + 1);
+}
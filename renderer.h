@@ -0,0 +1,126 @@
+#pragma once
+
+#include <QGLShaderProgram>
+#include <QDateTime>
+#include <QRect>
+#include <QString>
+
+#include <memory>
+#include <vector>
+
+#include "camera.h"
+#include "drawqueue.h"
+#include "engine.h"
+#include "parallel.h"
+#include "profiler.h"
+#include "shadercache.h"
+#include "trails.h"
+
+// One camera drawn into one rectangle of the bound framebuffer
+struct View
+{
+	QString name;
+	Camera camera;
+	// Framebuffer pixels, origin bottom left; empty keeps the current viewport
+	QRect viewport;
+};
+
+// Owns the shaders and bodies of the scene and draws them from one or more
+// views into whatever framebuffer is bound, so the window and the offscreen
+// modes share the same code. All views of a frame share one ephemeris
+// evaluation, survey scaling is applied per view
+struct Renderer : public QGLFunctions
+{
+	// Programs and passes as numbered in draw packet keys
+	enum shaders {
+		shaderDark,
+		shaderLight,
+		shaderSky,
+		shaderCount
+	};
+
+	enum drawPasses {
+		drawOpaque,
+		drawSky
+	};
+
+	// Bodies of one view that survived culling, rebuilt every frame in the
+	// view's own arena
+	struct DrawList
+	{
+		FrameArena arena;
+		DrawQueue queue;
+		int culled;
+		double buildMs;
+	};
+
+	// Smoothed cost of each view, the first is the main one
+	struct ViewStats
+	{
+		QString name;
+		double buildMs;
+		double drawMs;
+		int drawn;
+		int culled;
+		int drawCalls;
+	};
+
+	Renderer();
+	bool init(QGLContext *context);
+	bool initShaders();
+	void initObjects(QGLContext *context);
+
+	void changeTime(QDateTime const &time);
+	// Per frame simulation work that follows the cameras, after changeTime
+	// and before rendering the same views
+	void update(Camera const &camera);
+	void update(std::vector<View> const &views);
+	void clearKeyframes();
+	void render(Camera const &camera);
+	void render(std::vector<View> const &views);
+
+	// Frustum culled and sorted; safe to call from several threads
+	void buildDrawList(Camera const &camera, DrawList &list);
+	void drawView(View const &view, DrawList const &list, bool timePasses);
+	// Draws the packets of one pass starting at first, returns the next one
+	int submit(DrawQueue const &queue, int first, int pass, Camera const &camera, QMatrix4x4 const &projection);
+	void drawTrails(Camera const &camera, QMatrix4x4 const &projection);
+
+	QGLShaderProgram programLight;
+	QGLShaderProgram programDark;
+	QGLShaderProgram programSky;
+	QGLShaderProgram programOverdraw;
+	QGLShaderProgram programSkyOverdraw;
+	QGLShaderProgram programLine;
+	QGLShaderProgram programLineOverdraw;
+
+	// Additive constant color instead of shading, to show overdraw
+	bool overdraw;
+
+	std::unique_ptr<SphereEngine> theSun;
+	std::unique_ptr<SphereEngine> aSun;
+	std::unique_ptr<SphereEngine> theSky;
+	std::vector<std::unique_ptr<PlanetEngine>> planets;
+	std::vector<std::unique_ptr<PlanetEngine>> moons;
+	// Planets first, then moons
+	Trails trails;
+	double julianDay;
+
+	Profiler profiler;
+	ShaderCache shaderCache;
+	double shaderMs;
+
+	std::vector<ViewStats> viewStats;
+
+private:
+	void selectShader(int shader, QGLShaderProgram *&program, ProgramLocations const *&locations);
+
+	ProgramLocations locations[shaderCount];
+	ProgramLocations overdrawLocations[shaderCount];
+	Trails::Locations lineLocations;
+	Trails::Locations lineOverdrawLocations;
+
+	// Builds the draw lists of several views at once
+	ThreadPool pool;
+	std::vector<DrawList> drawLists;
+};
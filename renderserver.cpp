@@ -0,0 +1,212 @@
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QImageWriter>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QtEndian>
+
+#include <algorithm>
+
+#include "renderserver.h"
+#include "trace.h"
+
+RenderServer::RenderServer(QString const &name_, int threads)
+	:name(name_),
+	pool([this](int index, QImage const &image) {
+		QBuffer buffer(&encoded[index]);
+		buffer.open(QIODevice::WriteOnly);
+		// Read back bottom up, flipped here off the GL thread
+		if (!image.mirrored().save(&buffer, formats[index].constData()))
+			errors[index] = QString("could not encode as %1").arg(QString(formats[index]));
+	}, threads, threads * 2),
+	served(0),
+	busyMs(0)
+{}
+
+bool RenderServer::start()
+{
+	if (!target.init() || !renderer.init(target.glContext()))
+		return false;
+
+	QLocalServer::removeServer(name);
+	if (!server.listen(name)) {
+		qWarning() << "server:" << server.errorString();
+		return false;
+	}
+	connect(&server, &QLocalServer::newConnection, [this] {
+		while (QLocalSocket *socket = server.nextPendingConnection()) {
+			connect(socket, &QLocalSocket::readyRead, [this, socket] { serve(socket); });
+			connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+		}
+	});
+	qDebug() << "server: listening on" << server.fullServerName();
+	return true;
+}
+
+void RenderServer::serve(QLocalSocket *socket)
+{
+	while (socket->canReadLine()) {
+		QJsonParseError error;
+		QJsonDocument request = QJsonDocument::fromJson(socket->readLine(), &error);
+		if (!request.isObject()) {
+			qWarning() << "server: bad request" << error.errorString();
+			socket->disconnectFromServer();
+			return;
+		}
+		renderBatch(socket, request.object());
+	}
+}
+
+QOpenGLFramebufferObject *RenderServer::framebuffer(QSize const &size)
+{
+	auto &fbo = framebuffers[std::make_pair(size.width(), size.height())];
+	if (!fbo) {
+		// Requests usually come in a handful of sizes, don't hoard the rest
+		if (framebuffers.size() > 8) {
+			framebuffers.clear();
+			return framebuffer(size);
+		}
+		QOpenGLFramebufferObjectFormat format;
+		format.setAttachment(QOpenGLFramebufferObject::Depth);
+		fbo.reset(new QOpenGLFramebufferObject(size, format));
+	}
+	return fbo.get();
+}
+
+// Fills count numbers from a JSON array, false unless it has exactly that many
+static bool toNumbers(QJsonValue const &value, int count, double *numbers)
+{
+	QJsonArray array = value.toArray();
+	if (!value.isArray() || array.size() != count)
+		return false;
+	for (int idx = 0; idx < count; ++idx) {
+		if (!array.at(idx).isDouble())
+			return false;
+		numbers[idx] = array.at(idx).toDouble();
+	}
+	return true;
+}
+
+// An absent field takes the default, a present one has to be a number in range
+static bool toNumber(QJsonObject const &snapshot, char const *field, double fallback, double min, double max, double &number)
+{
+	QJsonValue value = snapshot[field];
+	number = value.isUndefined() ? fallback : value.toDouble(min - 1);
+	return number >= min && number <= max;
+}
+
+QOpenGLFramebufferObject *RenderServer::renderSnapshot(QJsonObject const &snapshot, QString &error)
+{
+	TRACE_ZONE("RenderServer::renderSnapshot");
+
+	double width, height, fov;
+	if (!toNumber(snapshot, "width", 256, 1, 8192, width) || !toNumber(snapshot, "height", 256, 1, 8192, height)) {
+		error = "width and height must be between 1 and 8192";
+		return 0;
+	}
+	if (!toNumber(snapshot, "fov", 45, 1, 170, fov)) {
+		error = "fov must be between 1 and 170 degrees";
+		return 0;
+	}
+	QSize size(width, height);
+
+	QDateTime time = QDateTime::currentDateTimeUtc();
+	if (snapshot.contains("time")) {
+		time = QDateTime::fromString(snapshot["time"].toString(), Qt::ISODate).toUTC();
+		if (!time.isValid()) {
+			error = "time is not an ISO 8601 date";
+			return 0;
+		}
+	}
+
+	double position[3] = {0, 0, 0};
+	if (snapshot.contains("position") && !toNumbers(snapshot["position"], 3, position)) {
+		error = "position must be [x, y, z]";
+		return 0;
+	}
+	double target[3], direction[2] = {0, 0};
+	bool hasTarget = snapshot.contains("target");
+	if (hasTarget && !toNumbers(snapshot["target"], 3, target)) {
+		error = "target must be [x, y, z]";
+		return 0;
+	}
+	if (!hasTarget && snapshot.contains("direction") && !toNumbers(snapshot["direction"], 2, direction)) {
+		error = "direction must be [yaw, pitch]";
+		return 0;
+	}
+
+	renderer.changeTime(time);
+
+	Camera camera;
+	camera.survey = snapshot["survey"].toBool();
+	camera.position = QVector3D(position[0], position[1], position[2]);
+	if (hasTarget) {
+		camera.lookAt(QVector3D(target[0], target[1], target[2]));
+	} else {
+		camera.viewRight(direction[0]);
+		camera.viewUp(direction[1]);
+	}
+	camera.viewAngle = fov;
+	camera.aspect = qreal(size.width()) / size.height();
+
+	QOpenGLFramebufferObject *fbo = framebuffer(size);
+	fbo->bind();
+	glViewport(0, 0, size.width(), size.height());
+	renderer.render(camera);
+	return fbo;
+}
+
+void RenderServer::renderBatch(QLocalSocket *socket, QJsonObject const &request)
+{
+	TRACE_ZONE("RenderServer::renderBatch");
+	QElapsedTimer timer;
+	timer.start();
+
+	QJsonArray snapshots = request["snapshots"].toArray();
+	encoded.assign(snapshots.size(), QByteArray());
+	formats.assign(snapshots.size(), QByteArray());
+	errors.assign(snapshots.size(), QString());
+
+	// Snapshot index of each readback. Read n is mapped once n + 2 has been
+	// rendered and read, and encodes on the pool while later ones render
+	std::vector<int> reads;
+	auto collect = [&](int read) {
+		pool.submit(reads[read], readback.take(read));
+	};
+
+	QList<QByteArray> const writable = QImageWriter::supportedImageFormats();
+	for (int idx = 0; idx < snapshots.size(); ++idx) {
+		QJsonObject snapshot = snapshots.at(idx).toObject();
+		formats[idx] = snapshot["format"].toString("png").toUpper().toLatin1();
+		if (!writable.contains(formats[idx].toLower())) {
+			errors[idx] = QString("unknown format %1").arg(QString(formats[idx]));
+			continue;
+		}
+		QOpenGLFramebufferObject *fbo = renderSnapshot(snapshot, errors[idx]);
+		if (!fbo)
+			continue;
+		readback.read(reads.size(), fbo->size());
+		reads.push_back(idx);
+		if (reads.size() >= ReadbackRing::depth)
+			collect(reads.size() - ReadbackRing::depth);
+	}
+	for (int read = std::max<int>(0, reads.size() - (ReadbackRing::depth - 1)); read < int(reads.size()); ++read)
+		collect(read);
+	pool.wait();
+
+	for (int idx = 0; idx < snapshots.size(); ++idx) {
+		QByteArray const &payload = errors[idx].isEmpty() ? encoded[idx] : errors[idx].toUtf8();
+		if (!errors[idx].isEmpty())
+			qWarning() << "server: snapshot" << idx << errors[idx];
+		uchar length[4];
+		qToBigEndian<quint32>(payload.size() | (errors[idx].isEmpty() ? 0 : 0x80000000u), length);
+		socket->write(reinterpret_cast<char const *>(length), 4);
+		socket->write(payload);
+	}
+	socket->flush();
+
+	served += snapshots.size();
+	busyMs += timer.nsecsElapsed() / 1e6;
+	qDebug() << "server:" << snapshots.size() << "snapshots in" << timer.elapsed() << "ms,"
+		<< served * 1000.0 / busyMs << "snapshots/s overall";
+}
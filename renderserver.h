@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QJsonObject>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "encoder.h"
+#include "offscreen.h"
+#include "renderer.h"
+
+// Headless snapshot service on a local socket. Every request is one line
+// of JSON: {"snapshots": [{"time", "position", "direction" or "target",
+// "fov", "width", "height", "survey", "format"}, ...]}. Each snapshot is
+// answered in order with a 4-byte big-endian length and the encoded image.
+// A length with the high bit set marks an error frame instead: the low 31
+// bits give the length of a UTF-8 message saying which field was rejected
+// (time that does not parse, fov outside 1..170, size outside 1..8192, an
+// unknown format or a malformed vector). The rest of the batch still renders.
+// Shaders, textures and meshes are set up once and shared by all requests,
+// and snapshots are read back through a ring of pixel buffers and encoded
+// on worker threads while the following ones render.
+class RenderServer : public QObject
+{
+	Q_OBJECT
+
+public:
+	RenderServer(QString const &name_, int threads);
+	bool start();
+
+private:
+	void serve(QLocalSocket *socket);
+	void renderBatch(QLocalSocket *socket, QJsonObject const &request);
+	// Null with error set if a field of the snapshot is invalid
+	QOpenGLFramebufferObject *renderSnapshot(QJsonObject const &snapshot, QString &error);
+	QOpenGLFramebufferObject *framebuffer(QSize const &size);
+
+	QString const name;
+	QLocalServer server;
+	// Context only, snapshots render into the cached framebuffers
+	OffscreenTarget target;
+	Renderer renderer;
+	ReadbackRing readback;
+	std::map<std::pair<int, int>, std::unique_ptr<QOpenGLFramebufferObject>> framebuffers;
+
+	// Encoded images of the current batch, filled by the encoder threads
+	std::vector<QByteArray> encoded;
+	std::vector<QByteArray> formats;
+	std::vector<QString> errors;
+	EncoderPool pool;
+
+	quint64 served;
+	double busyMs;
+};
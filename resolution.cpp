@@ -0,0 +1,40 @@
+#include <algorithm>
+#include <cmath>
+
+#include "resolution.h"
+
+ResolutionScaler::ResolutionScaler(double budgetMs_)
+	:enabled(false),
+	budgetMs(budgetMs_),
+	scale(1),
+	savedMs(0),
+	minScale(.35),
+	maxScale(1),
+	frames(0)
+{}
+
+void ResolutionScaler::update(double gpuMs)
+{
+	if (gpuMs <= 0)
+		return;
+	savedMs = gpuMs / (scale * scale) - gpuMs;
+
+	// Timings lag a few frames behind and are smoothed, give a change time
+	// to show up before reacting again
+	if (++frames < 10)
+		return;
+	frames = 0;
+
+	double next = scale;
+	if (gpuMs > budgetMs * 1.05)
+		next = scale * std::max(.9, std::sqrt(budgetMs / gpuMs));
+	else if (gpuMs < budgetMs * .8)
+		next = scale * 1.05;
+	scale = std::min(maxScale, std::max(minScale, next));
+}
+
+QSize ResolutionScaler::targetSize(QSize const &window) const
+{
+	double s = enabled ? scale : 1;
+	return QSize(std::max(1, static_cast<int>(window.width() * s)), std::max(1, static_cast<int>(window.height() * s)));
+}
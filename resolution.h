@@ -0,0 +1,26 @@
+#pragma once
+
+#include <QSize>
+
+// Picks the fraction of the window resolution to render at so that the
+// measured GPU time of the scene approaches budgetMs. Fill cost is assumed
+// to scale with the pixel count, i.e. with scale squared.
+struct ResolutionScaler
+{
+	explicit ResolutionScaler(double budgetMs_ = 16.7);
+
+	void update(double gpuMs);
+	QSize targetSize(QSize const &window) const;
+
+	bool enabled;
+	double budgetMs;
+	double scale;
+	// Estimated GPU time the lowered resolution saves per frame
+	double savedMs;
+
+	double const minScale;
+	double const maxScale;
+
+private:
+	int frames;
+};
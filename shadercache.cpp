@@ -0,0 +1,131 @@
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <cstring>
+
+#include "shadercache.h"
+#include "trace.h"
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#	define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#	define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#	define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+bool ShaderCache::enabled = true;
+
+ShaderCache::ShaderCache()
+	:hits(0),
+	misses(0),
+	getProgramBinary(0),
+	programBinary(0),
+	programParameteri(0),
+	resolved(false),
+	directory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/shaders")
+{}
+
+bool ShaderCache::resolve()
+{
+	if (resolved)
+		return getProgramBinary && programBinary;
+	resolved = true;
+
+	QOpenGLContext *context = QOpenGLContext::currentContext();
+	GLint formats = 0;
+	context->functions()->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	if (!formats)
+		return false;
+
+	getProgramBinary = reinterpret_cast<GetProgramBinary>(context->getProcAddress("glGetProgramBinary"));
+	programBinary = reinterpret_cast<ProgramBinary>(context->getProcAddress("glProgramBinary"));
+	programParameteri = reinterpret_cast<ProgramParameteri>(context->getProcAddress("glProgramParameteri"));
+	return getProgramBinary && programBinary;
+}
+
+bool ShaderCache::supported() const
+{
+	return resolved && getProgramBinary && programBinary;
+}
+
+static QByteArray readFile(QString const &name)
+{
+	QFile file(name);
+	file.open(QIODevice::ReadOnly);
+	return file.readAll();
+}
+
+bool ShaderCache::compile(QGLShaderProgram &program, QString const &vertexFile, QString const &fragmentFile)
+{
+	TRACE_ZONE("ShaderCache::compile");
+	++misses;
+	if (!program.addShaderFromSourceFile(QGLShader::Vertex, vertexFile)
+		|| !program.addShaderFromSourceFile(QGLShader::Fragment, fragmentFile))
+		return false;
+	if (programParameteri)
+		programParameteri(program.programId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	return program.link();
+}
+
+bool ShaderCache::load(QGLShaderProgram &program, QString const &vertexFile, QString const &fragmentFile)
+{
+	if (!enabled || !resolve())
+		return compile(program, vertexFile, fragmentFile);
+
+	QOpenGLFunctions *gl = QOpenGLContext::currentContext()->functions();
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	hash.addData(readFile(vertexFile));
+	hash.addData(readFile(fragmentFile));
+	hash.addData(reinterpret_cast<char const *>(gl->glGetString(GL_VENDOR)));
+	hash.addData(reinterpret_cast<char const *>(gl->glGetString(GL_RENDERER)));
+	hash.addData(reinterpret_cast<char const *>(gl->glGetString(GL_VERSION)));
+	// QGLShaderProgram prepends its own defines to the sources
+	hash.addData(QByteArray::number(QT_VERSION, 16));
+	QString fileName = QDir(directory).filePath(hash.result().toHex() + ".bin");
+
+	// File layout: binary format enum, then the binary itself
+	QByteArray cached = readFile(fileName);
+	if (cached.size() > int(sizeof(GLenum))) {
+		TRACE_ZONE("ShaderCache::load");
+		GLenum format;
+		std::memcpy(&format, cached.constData(), sizeof(format));
+		programBinary(program.programId(), format, cached.constData() + sizeof(format), cached.size() - sizeof(format));
+
+		// Without shaders attached link() only checks the link status
+		if (program.link()) {
+			++hits;
+			return true;
+		}
+		// Rejected, typically after a driver update
+		QFile::remove(fileName);
+	}
+
+	if (!compile(program, vertexFile, fragmentFile))
+		return false;
+
+	GLint length = 0;
+	gl->glGetProgramiv(program.programId(), GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return true;
+	QByteArray binary(sizeof(GLenum) + length, Qt::Uninitialized);
+	GLenum format = 0;
+	getProgramBinary(program.programId(), length, &length, &format, binary.data() + sizeof(GLenum));
+	std::memcpy(binary.data(), &format, sizeof(format));
+	binary.resize(sizeof(GLenum) + length);
+
+	QDir().mkpath(directory);
+	QSaveFile file(fileName);
+	if (file.open(QIODevice::WriteOnly)) {
+		file.write(binary);
+		file.commit();
+	}
+	return true;
+}
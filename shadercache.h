@@ -0,0 +1,35 @@
+#pragma once
+
+#include <QGLShaderProgram>
+#include <QString>
+
+// Keeps linked program binaries (glGetProgramBinary) on disk, keyed by the
+// shader sources and the GL vendor, renderer and version strings, and
+// falls back to compiling from source on a miss or a rejected binary
+struct ShaderCache
+{
+	ShaderCache();
+	bool load(QGLShaderProgram &program, QString const &vertexFile, QString const &fragmentFile);
+	// False when the driver offers no program binary formats; only known
+	// once load() has run
+	bool supported() const;
+
+	int hits;
+	int misses;
+
+	static bool enabled;
+
+private:
+	bool compile(QGLShaderProgram &program, QString const &vertexFile, QString const &fragmentFile);
+	bool resolve();
+
+	typedef void (QOPENGLF_APIENTRYP GetProgramBinary)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+	typedef void (QOPENGLF_APIENTRYP ProgramBinary)(GLuint program, GLenum binaryFormat, void const *binary, GLsizei length);
+	typedef void (QOPENGLF_APIENTRYP ProgramParameteri)(GLuint program, GLenum pname, GLint value);
+
+	GetProgramBinary getProgramBinary;
+	ProgramBinary programBinary;
+	ProgramParameteri programParameteri;
+	bool resolved;
+	QString directory;
+};
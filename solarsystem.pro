@@ -0,0 +1,7 @@
+TEMPLATE = subdirs
+
+# The viewer and the microbenchmarks share sources but not binaries, so
+# the counting operator new in microbench.cpp never reaches cube
+SUBDIRS = cube bench
+cube.file = cube.pro
+bench.file = bench.pro
@@ -0,0 +1,113 @@
+#include <QFile>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "trace.h"
+
+std::atomic<bool> Trace::enabled(false);
+
+namespace {
+
+struct Ring
+{
+	enum {
+		size = 1 << 16
+	};
+
+	explicit Ring(int tid_)
+		:events(size),
+		head(0),
+		writing(false),
+		tid(tid_)
+	{}
+
+	std::vector<Trace::Event> events;
+	std::atomic<quint64> head;
+	// Set while the owner thread writes an event, dump() waits for it
+	std::atomic<bool> writing;
+	int const tid;
+};
+
+// Rings are registered once per thread and live until exit
+std::mutex ringsMutex;
+std::vector<std::unique_ptr<Ring>> rings;
+thread_local Ring *threadRing = 0;
+
+Ring *getRing()
+{
+	if (!threadRing) {
+		std::lock_guard<std::mutex> lock(ringsMutex);
+		rings.push_back(std::unique_ptr<Ring>(new Ring(rings.size() + 1)));
+		threadRing = rings.back().get();
+	}
+	return threadRing;
+}
+
+}
+
+qint64 Trace::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Trace::record(char const *name, qint64 begin, qint64 end)
+{
+	Ring *ring = getRing();
+
+	// Announce the write before checking the flag: dump() clears the flag
+	// before waiting for writers, so one of the two always sees the other.
+	// Zones opened before tracing was turned off are dropped here
+	ring->writing.store(true);
+	if (enabled.load()) {
+		quint64 head = ring->head.load(std::memory_order_relaxed);
+		Event &event = ring->events[head & (Ring::size - 1)];
+		event.name = name;
+		event.begin = begin;
+		event.duration = end - begin;
+		ring->head.store(head + 1, std::memory_order_release);
+	}
+	ring->writing.store(false, std::memory_order_release);
+}
+
+bool Trace::dump(QString const &fileName, qint64 windowMsecs)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return false;
+
+	qint64 from = now() - windowMsecs * 1000000;
+	QByteArray json("{\"traceEvents\":[\n");
+	bool first = true;
+
+	// Stop the writers for the copy, the rings are plain memory
+	bool wasEnabled = enabled.exchange(false);
+	std::lock_guard<std::mutex> lock(ringsMutex);
+	for (auto const &ring : rings)
+		while (ring->writing.load())
+			std::this_thread::yield();
+
+	for (auto const &ring : rings) {
+		quint64 head = ring->head.load(std::memory_order_acquire);
+		quint64 tail = head > Ring::size ? head - Ring::size : 0;
+		for (quint64 idx = tail; idx < head; ++idx) {
+			Event const &event = ring->events[idx & (Ring::size - 1)];
+			if (event.begin < from)
+				continue;
+			if (!first)
+				json += ",\n";
+			first = false;
+			json += QString("{\"name\":\"%1\",\"ph\":\"X\",\"pid\":1,\"tid\":%2,\"ts\":%3,\"dur\":%4}")
+				.arg(event.name).arg(ring->tid)
+				.arg(event.begin / 1000.0, 0, 'f', 3).arg(event.duration / 1000.0, 0, 'f', 3).toUtf8();
+		}
+	}
+	enabled.store(wasEnabled);
+
+	json += "\n]}\n";
+	return file.write(json) == json.size();
+}
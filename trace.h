@@ -0,0 +1,46 @@
+#pragma once
+
+#include <QString>
+
+#include <atomic>
+
+// Scoped CPU zones. Events go to a lock-free ring buffer owned by the
+// recording thread; when tracing is off a zone costs one relaxed load.
+// dump() pauses recording while it copies the rings.
+struct Trace
+{
+	struct Event
+	{
+		char const *name;
+		qint64 begin;
+		qint64 duration;
+	};
+
+	static qint64 now();
+	static void record(char const *name, qint64 begin, qint64 end);
+	// Writes the last windowMsecs of events from all threads as Chrome trace JSON
+	static bool dump(QString const &fileName, qint64 windowMsecs = 10000);
+
+	static std::atomic<bool> enabled;
+};
+
+struct TraceZone
+{
+	explicit TraceZone(char const *name_)
+		:name(name_),
+		begin(Trace::enabled.load(std::memory_order_relaxed) ? Trace::now() : 0)
+	{}
+
+	~TraceZone()
+	{
+		if (begin)
+			Trace::record(name, begin, Trace::now());
+	}
+
+	char const *name;
+	qint64 begin;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
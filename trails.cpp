@@ -0,0 +1,234 @@
+#include <QOpenGLContext>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include "profiler.h"
+#include "trails.h"
+#include "trace.h"
+
+float const Trails::tolerance = 1e-3f;
+double const Trails::elementTolerance = 1e-4;
+
+void Trails::Locations::resolve(QGLShaderProgram &program)
+{
+	position = program.attributeLocation("a_position");
+	params = program.attributeLocation("a_params");
+	projection = program.uniformLocation("projection_matrix");
+	camera = program.uniformLocation("camera");
+	survey = program.uniformLocation("survey");
+	origins = program.uniformLocation("origins");
+	color = program.uniformLocation("color");
+}
+
+Trails::Trails()
+	:enabled(false),
+	uploads(0),
+	uploadedBytes(0),
+	vboId(0),
+	multiDrawArrays(0)
+{}
+
+void Trails::init(QGLContext *context, int bodies)
+{
+	initializeGLFunctions(context);
+	// Core since GL 1.4, but not part of ES 2
+	multiDrawArrays = reinterpret_cast<MultiDrawArrays>(QOpenGLContext::currentContext()->getProcAddress("glMultiDrawArrays"));
+	states.assign(bodies, Body());
+	clear();
+
+	// Each trail slot is stored twice, at i and i + trailCapacity, so the
+	// newest samples are always one contiguous line strip
+	vertices.assign(bodies * (orbitVertices + 2 * trailCapacity), Vertex{QVector3D(), 1, 0});
+	glGenBuffers(1, &vboId);
+	glBindBuffer(GL_ARRAY_BUFFER, vboId);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_DYNAMIC_DRAW);
+}
+
+void Trails::clear()
+{
+	for (auto &state : states) {
+		state.hasOrbit = false;
+		state.surveyScale = 0;
+		state.count = 0;
+	}
+}
+
+int Trails::trailBase(int body) const
+{
+	return states.size() * orbitVertices + body * 2 * trailCapacity;
+}
+
+void Trails::markDirty(int from, int to)
+{
+	dirty.push_back(std::make_pair(from, to));
+}
+
+void Trails::rebuildOrbit(int body, PlanetImpl &impl, PlanetImpl::Orbit const &orbit, double jdn)
+{
+	TRACE_ZONE("Trails::rebuildOrbit");
+	Body &state = states[body];
+	state.orbit = orbit;
+	state.hasOrbit = true;
+
+	// The survey scale only depends on a, which is what the drift check
+	// watches, so it is refreshed together with the ellipse
+	float surveyScale = impl.getSurveyScale(jdn);
+	if (surveyScale != state.surveyScale) {
+		state.surveyScale = surveyScale;
+		int base = trailBase(body);
+		for (int idx = 0; idx < 2 * trailCapacity; ++idx)
+			vertices[base + idx].surveyScale = surveyScale;
+		markDirty(base, base + 2 * trailCapacity);
+	}
+
+	int base = body * orbitVertices;
+	for (int idx = 0; idx < orbitVertices; ++idx)
+		vertices[base + idx] = Vertex{impl.getEllipsePos(orbit, 2 * M_PI * idx / orbitVertices), surveyScale, float(state.parent + 1)};
+	markDirty(base, base + orbitVertices);
+}
+
+void Trails::write(int body, QVector3D const &position)
+{
+	// Trails are stored in world coordinates, relative to the sun
+	int slot = trailBase(body) + states[body].head;
+	Vertex vertex = {position, states[body].surveyScale, 0};
+	vertices[slot] = vertex;
+	vertices[slot + trailCapacity] = vertex;
+	markDirty(slot, slot + 1);
+	markDirty(slot + trailCapacity, slot + trailCapacity + 1);
+}
+
+static bool drifted(PlanetImpl::Orbit const &lhs, PlanetImpl::Orbit const &rhs)
+{
+	double const tolerance = Trails::elementTolerance;
+	return std::abs(lhs.a - rhs.a) > tolerance * std::abs(rhs.a)
+		|| std::abs(lhs.e - rhs.e) > tolerance
+		|| std::abs(lhs.i - rhs.i) > tolerance
+		|| std::abs(lhs.w - rhs.w) > tolerance
+		|| std::abs(lhs.W - rhs.W) > tolerance;
+}
+
+void Trails::update(int body, int parent, PlanetImpl &impl, double jdn, QVector3D const &position, float distance)
+{
+	Body &state = states[body];
+	state.parent = parent;
+	if (state.count && state.lastJdn == jdn)
+		return;
+
+	// The elements drift by fractions of a degree per century, the
+	// ellipse is only rebuilt when that becomes visible
+	PlanetImpl::Orbit orbit = impl.getEphemeris(jdn);
+	if (!state.hasOrbit || drifted(orbit, state.orbit))
+		rebuildOrbit(body, impl, orbit, jdn);
+
+	// Seeks and steps of more than a quarter orbit would draw chords across
+	// the orbit, start a new trail instead
+	double period = impl.getOrbitalPeriod();
+	if (!state.count || std::abs(jdn - state.lastJdn) > period / 4) {
+		state.head = 0;
+		state.count = 1;
+		state.committed = position;
+		state.previous = position;
+		state.committedJdn = jdn;
+		state.lastJdn = jdn;
+		write(body, position);
+		return;
+	}
+
+	// The segment from the last sample to the live head must still pass
+	// close to where the body was last frame, measured as an angle on screen
+	float error = state.previous.distanceToLine(state.committed, (position - state.committed).normalized());
+	if (error > tolerance * distance || std::abs(jdn - state.committedJdn) > period / samplesPerOrbit) {
+		// Keep last frame's head as a sample and start a new live head
+		state.head = (state.head + 1) % trailCapacity;
+		state.count = std::min<int>(state.count + 1, trailCapacity);
+		state.committed = state.previous;
+		state.committedJdn = state.lastJdn;
+	}
+	write(body, position);
+	state.previous = position;
+	state.lastJdn = jdn;
+}
+
+void Trails::upload()
+{
+	TRACE_ZONE("Trails::upload");
+	uploads = 0;
+	uploadedBytes = 0;
+	if (dirty.empty())
+		return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, vboId);
+	std::sort(dirty.begin(), dirty.end());
+	std::pair<int, int> range = dirty[0];
+	for (unsigned idx = 1; idx <= dirty.size(); ++idx) {
+		if (idx < dirty.size() && dirty[idx].first <= range.second + uploadGap) {
+			range.second = std::max(range.second, dirty[idx].second);
+			continue;
+		}
+		int bytes = (range.second - range.first) * sizeof(Vertex);
+		glBufferSubData(GL_ARRAY_BUFFER, range.first * sizeof(Vertex), bytes, &vertices[range.first]);
+		++uploads;
+		uploadedBytes += bytes;
+		if (idx < dirty.size())
+			range = dirty[idx];
+	}
+	dirty.clear();
+}
+
+void Trails::multiDraw(GLenum mode)
+{
+	if (firsts.empty())
+		return;
+	if (multiDrawArrays) {
+		multiDrawArrays(mode, &firsts[0], &counts[0], firsts.size());
+		++Profiler::counters.drawCalls;
+		return;
+	}
+	for (unsigned idx = 0; idx < firsts.size(); ++idx)
+		glDrawArrays(mode, firsts[idx], counts[idx]);
+	Profiler::counters.drawCalls += static_cast<int>(firsts.size());
+}
+
+void Trails::draw(QGLShaderProgram &program, Locations const &locations, QMatrix4x4 const &projection, QVector3D const &camera,
+	bool survey, int bodies, QVector3D const *origins, int originCount)
+{
+	TRACE_ZONE("Trails::draw");
+	glBindBuffer(GL_ARRAY_BUFFER, vboId);
+	program.enableAttributeArray(locations.position);
+	glVertexAttribPointer(locations.position, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void const *>(offsetof(Vertex, position)));
+	program.enableAttributeArray(locations.params);
+	glVertexAttribPointer(locations.params, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void const *>(offsetof(Vertex, surveyScale)));
+
+	program.setUniformValue(locations.projection, projection);
+	program.setUniformValue(locations.camera, camera);
+	program.setUniformValue(locations.survey, survey ? 1.0f : 0.0f);
+	program.setUniformValueArray(locations.origins, origins, std::min<int>(originCount, maxOrigins));
+
+	firsts.clear();
+	counts.clear();
+	for (int body = 0; body < bodies; ++body)
+		if (states[body].hasOrbit) {
+			firsts.push_back(body * orbitVertices);
+			counts.push_back(orbitVertices);
+		}
+	program.setUniformValue(locations.color, QVector4D(.25f, .25f, .35f, 1));
+	multiDraw(GL_LINE_LOOP);
+
+	firsts.clear();
+	counts.clear();
+	for (int body = 0; body < bodies; ++body) {
+		Body const &state = states[body];
+		if (state.count > 1) {
+			firsts.push_back(trailBase(body) + state.head + trailCapacity - state.count + 1);
+			counts.push_back(state.count);
+		}
+	}
+	program.setUniformValue(locations.color, QVector4D(.9f, .8f, .5f, 1));
+	multiDraw(GL_LINE_STRIP);
+
+	program.disableAttributeArray(locations.position);
+	program.disableAttributeArray(locations.params);
+}
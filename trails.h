@@ -0,0 +1,112 @@
+#pragma once
+
+#include <QGLFunctions>
+#include <QGLShaderProgram>
+#include <QMatrix4x4>
+#include <QVector3D>
+
+#include <utility>
+#include <vector>
+
+#include "ephemeris.h"
+
+// Orbit ellipses and motion trails of every body in one shared vertex
+// buffer. A trail is a ring of adaptively spaced samples ending in a live
+// head at the current position, and only the vertices that changed since
+// the last frame are uploaded. Each vertex carries its body's survey scale
+// and the index of the origin it is relative to, so all ellipses and all
+// trails go out in one multi-draw each whatever the number of bodies
+struct Trails : public QGLFunctions
+{
+	// Attribute and uniform locations of a program using vshaderLine.glsl
+	struct Locations
+	{
+		void resolve(QGLShaderProgram &program);
+
+		int position;
+		int params;
+		int projection;
+		int camera;
+		int survey;
+		int origins;
+		int color;
+	};
+
+	Trails();
+	void init(QGLContext *context, int bodies);
+	void clear();
+
+	// Moons pass the index of their planet as parent, -1 orbits the sun.
+	// Positions are true scale. distance is the nearest view's distance to
+	// the body in the same units. Samples are kept dense enough for that
+	// view, so a close-up of a body shortens its trail in every view
+	void update(int body, int parent, PlanetImpl &impl, double jdn, QVector3D const &position, float distance);
+	void upload();
+	// origins[0] is the sun, origins[1 + planet] the parents of moons.
+	// Survey views scale every vertex by its body's scale about the sun
+	void draw(QGLShaderProgram &program, Locations const &locations, QMatrix4x4 const &projection, QVector3D const &camera,
+		bool survey, int bodies, QVector3D const *origins, int originCount);
+
+	bool enabled;
+	int uploads;
+	int uploadedBytes;
+
+	enum {
+		orbitVertices = 256,
+		trailCapacity = 256,
+		// Time bound on the sample spacing, keeps a trail within about one orbit
+		samplesPerOrbit = 256,
+		// Closer vertices are uploaded with the gap in between
+		uploadGap = 64,
+		// Size of the origins array in vshaderLine.glsl
+		maxOrigins = 16
+	};
+	// Largest deviation of a trail segment from the path, as an angle seen
+	// from the camera, in radians
+	static float const tolerance;
+	// Element drift that triggers an ellipse rebuild, relative for a and
+	// absolute for e and the angles
+	static double const elementTolerance;
+
+private:
+	struct Vertex
+	{
+		// True scale, relative to the origin
+		QVector3D position;
+		float surveyScale;
+		float origin;
+	};
+
+	struct Body
+	{
+		PlanetImpl::Orbit orbit;
+		bool hasOrbit;
+		int parent;
+		float surveyScale;
+
+		int head;
+		int count;
+		QVector3D committed;
+		QVector3D previous;
+		double committedJdn;
+		double lastJdn;
+	};
+
+	void rebuildOrbit(int body, PlanetImpl &impl, PlanetImpl::Orbit const &orbit, double jdn);
+	void write(int body, QVector3D const &position);
+	void markDirty(int from, int to);
+	int trailBase(int body) const;
+	void multiDraw(GLenum mode);
+
+	typedef void (QOPENGLF_APIENTRYP MultiDrawArrays)(GLenum mode, GLint const *first, GLsizei const *count, GLsizei drawcount);
+
+	GLuint vboId;
+	// Null where the driver lacks it, then the ranges are drawn one by one
+	MultiDrawArrays multiDrawArrays;
+	std::vector<Body> states;
+	std::vector<Vertex> vertices;
+	std::vector<std::pair<int, int>> dirty;
+	// Ranges of the current multi-draw, kept to avoid allocating per frame
+	std::vector<GLint> firsts;
+	std::vector<GLsizei> counts;
+};
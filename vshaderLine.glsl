@@ -0,0 +1,27 @@
+#ifdef GL_ES
+// Set default precision to medium
+precision mediump int;
+precision mediump float;
+#endif
+
+// Camera relative, the camera position is subtracted here
+uniform mat4 projection_matrix;
+uniform vec3 camera;
+// 1 in survey views, which scale every vertex about the sun
+uniform float survey;
+// The sun, then the planets moons are drawn relative to (Trails::maxOrigins)
+uniform vec3 origins[16];
+
+attribute vec4 a_position;
+// Survey scale of the body, index into origins
+attribute vec2 a_params;
+
+//! [0]
+void main()
+{
+    float scale = mix(1.0, a_params.x, survey);
+    vec3 world = origins[int(a_params.y + 0.5)] + a_position.xyz * scale;
+    // Calculate vertex position in screen space
+    gl_Position = projection_matrix * vec4(world - camera, 1.0);
+}
+//! [0]
@@ -0,0 +1,23 @@
+#ifdef GL_ES
+// Set default precision to medium
+precision mediump int;
+precision mediump float;
+#endif
+
+uniform mat4 projection_model_view_matrix;
+
+attribute vec4 a_position;
+attribute vec2 a_texcoord;
+
+varying vec2 v_texcoord;
+
+//! [0]
+void main()
+{
+    // Pin the sky to the far plane, so it is drawn last and only where
+    // nothing else has written depth
+    gl_Position = (projection_model_view_matrix * a_position).xyww;
+
+    v_texcoord = a_texcoord;
+}
+//! [0]